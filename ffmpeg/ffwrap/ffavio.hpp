@@ -0,0 +1,546 @@
+#pragma once
+
+extern "C" {
+#include "libavformat/avio.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+}
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "thread/thread_wrap.hpp"
+
+/// 本地文件的自定义 AVIO 配置
+struct FFIOOptions {
+    size_t bufferSize = 1 << 20; // AVIOContext 的缓冲区, 也是每次写系统调用的大小
+    size_t readAheadSize = 16 << 20; // 输入预读环形缓冲区的大小
+    bool mmapInput = false; // 输入改用 mmap, 映射失败(如 32 位进程映射超大文件)时退回预读
+};
+
+/// 自定义 AVIOContext 的基类, 派生类实现读/写/seek, 统计实际发生的系统调用
+class FFIOBase {
+public:
+    struct Statistic {
+        uint64_t syscalls = 0;
+        uint64_t bytes = 0;
+        uint64_t seeks = 0;
+    };
+
+    virtual ~FFIOBase()
+    {
+        freeContext();
+    }
+
+    AVIOContext* get() const
+    {
+        return context;
+    }
+
+    Statistic getStatistic() const
+    {
+        Statistic statistic;
+        statistic.syscalls = syscalls.load(std::memory_order_relaxed);
+        statistic.bytes = bytes.load(std::memory_order_relaxed);
+        statistic.seeks = seeks.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+protected:
+    FFIOBase() = default;
+
+    FFIOBase(const FFIOBase&) = delete;
+
+    FFIOBase& operator=(const FFIOBase&) = delete;
+
+    virtual int readPacket(uint8_t* buf, int size)
+    {
+        return AVERROR(ENOSYS);
+    }
+
+    virtual int writePacket(uint8_t* buf, int size)
+    {
+        return AVERROR(ENOSYS);
+    }
+
+    /// whence 可能带 AVSEEK_SIZE, 此时返回文件大小
+    virtual int64_t seek(int64_t offset, int whence) = 0;
+
+    bool allocContext(size_t bufferSize, bool write)
+    {
+        auto buffer = static_cast<unsigned char*>(av_malloc(bufferSize));
+        if (buffer == nullptr) {
+            return false;
+        }
+        context = avio_alloc_context(buffer, static_cast<int>(bufferSize), write ? 1 : 0, this,
+            write ? nullptr : &FFIOBase::ReadPacket, write ? &FFIOBase::WritePacket : nullptr, &FFIOBase::Seek);
+        if (context == nullptr) {
+            av_free(buffer);
+            return false;
+        }
+        return true;
+    }
+
+    /// 派生类析构时先调用, 保证剩余数据在文件关闭前写出
+    void freeContext()
+    {
+        if (context == nullptr) {
+            return;
+        }
+        if (context->write_flag) {
+            avio_flush(context);
+        }
+        av_freep(&context->buffer);
+        avio_context_free(&context);
+    }
+
+    static int64_t ResolveSeek(int64_t offset, int whence, int64_t current, int64_t size)
+    {
+        switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET:
+            return offset;
+        case SEEK_CUR:
+            return current + offset;
+        case SEEK_END:
+            return size + offset;
+        default:
+            return AVERROR(EINVAL);
+        }
+    }
+
+    void countSyscall(int64_t count)
+    {
+        syscalls.fetch_add(1, std::memory_order_relaxed);
+        countBytes(count);
+    }
+
+    void countBytes(int64_t count)
+    {
+        if (count > 0) {
+            bytes.fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+
+    void countSeek()
+    {
+        seeks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    static int ReadPacket(void* opaque, uint8_t* buf, int size)
+    {
+        return static_cast<FFIOBase*>(opaque)->readPacket(buf, size);
+    }
+
+    static int WritePacket(void* opaque, uint8_t* buf, int size)
+    {
+        return static_cast<FFIOBase*>(opaque)->writePacket(buf, size);
+    }
+
+    static int64_t Seek(void* opaque, int64_t offset, int whence)
+    {
+        return static_cast<FFIOBase*>(opaque)->seek(offset, whence);
+    }
+
+private:
+    AVIOContext* context = nullptr;
+    std::atomic<uint64_t> syscalls = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<uint64_t> seeks = 0;
+};
+
+/// 输出: 大缓冲区攒满后一次 pwrite, 支持 mp4 等需要回写文件头的格式的 seek
+class FFFileOutput final : public FFIOBase {
+public:
+    static std::unique_ptr<FFFileOutput> Open(const std::string& path, const FFIOOptions& options)
+    {
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        auto io = std::unique_ptr<FFFileOutput>(new FFFileOutput(fd));
+        if (!io->allocContext(options.bufferSize, true)) {
+            return nullptr;
+        }
+        return io;
+    }
+
+    ~FFFileOutput()
+    {
+        freeContext();
+        ::close(fd);
+    }
+
+private:
+    explicit FFFileOutput(int fd)
+        : fd(fd)
+    {
+    }
+
+    int writePacket(uint8_t* buf, int size) override
+    {
+        int written = 0;
+        while (written < size) {
+            const ssize_t result = ::pwrite(fd, buf + written, size - written, position);
+            countSyscall(result);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return AVERROR(errno);
+            }
+            written += result;
+            position += result;
+        }
+        fileSize = std::max(fileSize, position);
+        return written;
+    }
+
+    int64_t seek(int64_t offset, int whence) override
+    {
+        if (whence & AVSEEK_SIZE) {
+            return fileSize;
+        }
+        const int64_t target = ResolveSeek(offset, whence, position, fileSize);
+        if (target < 0) {
+            return AVERROR(EINVAL);
+        }
+        countSeek();
+        position = target;
+        return position;
+    }
+
+private:
+    int fd;
+    int64_t position = 0;
+    int64_t fileSize = 0;
+};
+
+/// 输入: 后台线程以大块 pread 预读到环形缓冲区, 解复用线程只做内存拷贝;
+/// 缓冲区内的前向 seek 直接跳过, 其他 seek 丢弃预读内容后从新位置重新预读
+class FFReadAheadInput final : public FFIOBase {
+public:
+    static std::unique_ptr<FFReadAheadInput> Open(const std::string& path, const FFIOOptions& options)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        auto io = std::unique_ptr<FFReadAheadInput>(new FFReadAheadInput(fd, st.st_size, std::max(options.readAheadSize, options.bufferSize)));
+        if (!io->allocContext(options.bufferSize, false)) {
+            return nullptr;
+        }
+        io->fetcher = std::make_unique<ThreadWrap>("ffio_readahead", [thiz = io.get()]() { thiz->fetchLoop(); });
+        return io;
+    }
+
+    ~FFReadAheadInput()
+    {
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            stop = true;
+        }
+        cond.notify_all();
+        fetcher.reset();
+        freeContext();
+        ::close(fd);
+    }
+
+private:
+    FFReadAheadInput(int fd, int64_t fileSize, size_t capacity)
+        : fd(fd)
+        , fileSize(fileSize)
+        , ring(capacity)
+    {
+    }
+
+    int readPacket(uint8_t* buf, int size) override
+    {
+        size_t available = 0;
+        size_t start = 0;
+        {
+            std::unique_lock<std::mutex> locker(mutex);
+            cond.wait(locker, [this]() { return filled > 0 || eof || error < 0 || stop; });
+            if (filled == 0) {
+                return error < 0 ? error : AVERROR_EOF;
+            }
+            available = std::min<size_t>(filled, size);
+            start = head;
+        }
+
+        // [head, head + filled) 只会被本线程消费, 预读线程不会改写, 可以在锁外拷贝
+        const size_t first = std::min(available, ring.size() - start);
+        memcpy(buf, ring.data() + start, first);
+        memcpy(buf + first, ring.data(), available - first);
+
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            consumeWithoutLock(available);
+        }
+        cond.notify_all();
+        return static_cast<int>(available);
+    }
+
+    int64_t seek(int64_t offset, int whence) override
+    {
+        if (whence & AVSEEK_SIZE) {
+            return fileSize;
+        }
+
+        std::lock_guard<std::mutex> locker(mutex);
+        const int64_t target = ResolveSeek(offset, whence, position, fileSize);
+        if (target < 0) {
+            return AVERROR(EINVAL);
+        }
+
+        countSeek();
+        if (target >= position && target - position <= static_cast<int64_t>(filled)) {
+            consumeWithoutLock(target - position);
+        } else {
+            generation += 1;
+            position = target;
+            fetchPosition = target;
+            head = 0;
+            filled = 0;
+            eof = false;
+            error = 0;
+        }
+        cond.notify_all();
+        return position;
+    }
+
+    void consumeWithoutLock(size_t count)
+    {
+        head = (head + count) % ring.size();
+        filled -= count;
+        position += count;
+    }
+
+    void fetchLoop()
+    {
+        static constexpr size_t FETCH_CHUNK = 1 << 20;
+        while (true) {
+            size_t tail = 0;
+            size_t length = 0;
+            int64_t offset = 0;
+            uint64_t fetchGeneration = 0;
+            {
+                std::unique_lock<std::mutex> locker(mutex);
+                cond.wait(locker, [this]() { return stop || (filled < ring.size() && !eof && error == 0); });
+                if (stop) {
+                    return;
+                }
+                tail = (head + filled) % ring.size();
+                length = std::min({ ring.size() - filled, ring.size() - tail, FETCH_CHUNK });
+                offset = fetchPosition;
+                fetchGeneration = generation;
+            }
+
+            // 写入的是空闲区, 消费者看不到; 期间发生 seek 则丢弃本次结果
+            const ssize_t result = ::pread(fd, ring.data() + tail, length, offset);
+            const int readErrno = errno;
+            countSyscall(result);
+            if (result < 0 && readErrno == EINTR) {
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> locker(mutex);
+                if (fetchGeneration != generation) {
+                    continue;
+                }
+                if (result > 0) {
+                    filled += result;
+                    fetchPosition += result;
+                } else if (result == 0) {
+                    eof = true;
+                } else {
+                    error = AVERROR(readErrno);
+                }
+            }
+            cond.notify_all();
+        }
+    }
+
+private:
+    int fd;
+    int64_t fileSize;
+    std::vector<uint8_t> ring;
+    std::unique_ptr<ThreadWrap> fetcher;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    int64_t position = 0; // 下一个交给 AVIO 的字节在文件中的偏移
+    int64_t fetchPosition = 0; // 预读线程下一次读取的偏移, 等于 position + filled
+    size_t head = 0;
+    size_t filled = 0;
+    uint64_t generation = 0;
+    bool eof = false;
+    int error = 0;
+    bool stop = false;
+};
+
+/// 输入: 整个文件只读映射, 读回调直接从映射区拷贝到 AVIO 的目标缓冲区, 没有 read 系统调用;
+/// 开启 AVIOContext::direct, 大块读取绕过 AVIO 内部缓冲直接拷到包缓冲区, 整条路径只有这一次拷贝.
+/// 已读过的区域定期 MADV_DONTNEED, 避免多 GB 文件把映射页全部计入常驻内存
+class FFMmapInput final : public FFIOBase {
+public:
+    static std::unique_ptr<FFMmapInput> Open(const std::string& path, const FFIOOptions& options)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0 || static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // 映射建立后不再需要文件描述符
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return nullptr;
+        }
+        madvise(addr, size, MADV_SEQUENTIAL);
+
+        auto io = std::unique_ptr<FFMmapInput>(new FFMmapInput(static_cast<const uint8_t*>(addr), size));
+        if (!io->allocContext(options.bufferSize, false)) {
+            return nullptr;
+        }
+        io->get()->direct = 1;
+        return io;
+    }
+
+    ~FFMmapInput()
+    {
+        freeContext();
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+
+private:
+    static constexpr size_t RELEASE_STEP = 64 << 20;
+
+    FFMmapInput(const uint8_t* data, size_t size)
+        : data(data)
+        , size(size)
+    {
+    }
+
+    int readPacket(uint8_t* buf, int length) override
+    {
+        if (position >= size) {
+            return AVERROR_EOF;
+        }
+
+        const size_t count = std::min<size_t>(length, size - position);
+        memcpy(buf, data + position, count);
+        countBytes(count);
+        position += count;
+        releaseConsumed();
+        return static_cast<int>(count);
+    }
+
+    int64_t seek(int64_t offset, int whence) override
+    {
+        if (whence & AVSEEK_SIZE) {
+            return static_cast<int64_t>(size);
+        }
+        const int64_t target = ResolveSeek(offset, whence, static_cast<int64_t>(position), static_cast<int64_t>(size));
+        if (target < 0) {
+            return AVERROR(EINVAL);
+        }
+        countSeek();
+        position = static_cast<size_t>(target);
+        if (position < released) {
+            // 回退到已释放的区域, 页面会在访问时重新缺页载入
+            released = position & ~(RELEASE_STEP - 1);
+        }
+        return target;
+    }
+
+    void releaseConsumed()
+    {
+        // 留一个步长的余量给 mp4 等格式的小范围回读
+        while (position >= released + 2 * RELEASE_STEP) {
+            madvise(const_cast<uint8_t*>(data) + released, RELEASE_STEP, MADV_DONTNEED);
+            released += RELEASE_STEP;
+        }
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    size_t released = 0; // [0, released) 已 MADV_DONTNEED
+};
+
+namespace FFIO {
+
+/// 没有协议头或以 file: 开头的 url 视为本地文件, 返回去掉协议头的路径
+static inline bool IsLocalFile(const std::string& url, std::string* path = nullptr)
+{
+    std::string local;
+    if (url.compare(0, 5, "file:") == 0) {
+        local = url.substr(5);
+    } else if (url.find("://") == std::string::npos) {
+        local = url;
+    } else {
+        return false;
+    }
+
+    if (path != nullptr) {
+        *path = std::move(local);
+    }
+    return true;
+}
+
+static inline std::unique_ptr<FFIOBase> OpenInput(const std::string& url, const FFIOOptions& options)
+{
+    std::string path;
+    if (!IsLocalFile(url, &path)) {
+        return nullptr;
+    }
+    if (options.mmapInput) {
+        if (auto io = FFMmapInput::Open(path, options)) {
+            return io;
+        }
+    }
+    return FFReadAheadInput::Open(path, options);
+}
+
+static inline std::unique_ptr<FFIOBase> OpenOutput(const std::string& url, const FFIOOptions& options)
+{
+    std::string path;
+    if (!IsLocalFile(url, &path)) {
+        return nullptr;
+    }
+    return FFFileOutput::Open(path, options);
+}
+
+}
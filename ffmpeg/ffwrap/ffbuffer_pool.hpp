@@ -0,0 +1,138 @@
+#pragma once
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/buffer.h"
+}
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/// 按大小分级的 AVBufferPool, 编码器直接写入池中的引用计数缓冲区, 再挂到 AVPacket 上交给 FFMuxer/FFRemuxer,
+/// 整条链路不再拷贝负载; 缓冲区最后一个引用释放时自动回到对应的池.
+/// 超过最大级别的请求退化为 av_buffer_alloc. 所有接口线程安全
+class FFBufferPool final {
+public:
+    struct Statistic {
+        uint64_t requests = 0;
+        uint64_t oversize = 0;
+        uint64_t failures = 0;
+    };
+
+    /// 默认覆盖音频包到 4K 关键帧
+    static std::shared_ptr<FFBufferPool> Make(std::vector<size_t> sizeClasses = { 4 << 10, 64 << 10, 512 << 10, 2 << 20, 8 << 20 })
+    {
+        auto pool = std::shared_ptr<FFBufferPool>(new FFBufferPool());
+        std::sort(sizeClasses.begin(), sizeClasses.end());
+        sizeClasses.erase(std::unique(sizeClasses.begin(), sizeClasses.end()), sizeClasses.end());
+        for (const auto size : sizeClasses) {
+            AVBufferPool* handle = av_buffer_pool_init(size + AV_INPUT_BUFFER_PADDING_SIZE, nullptr);
+            if (handle == nullptr) {
+                return nullptr;
+            }
+            pool->classes.push_back({ size, handle });
+        }
+        return pool;
+    }
+
+private:
+    explicit FFBufferPool() = default;
+
+public:
+    FFBufferPool(const FFBufferPool&) = delete;
+
+    FFBufferPool& operator=(const FFBufferPool&) = delete;
+
+    ~FFBufferPool()
+    {
+        // 已借出的缓冲区仍然有效, 池在它们全部释放后才真正销毁
+        for (auto& sizeClass : classes) {
+            av_buffer_pool_uninit(&sizeClass.handle);
+        }
+    }
+
+    /// 返回至少 size 字节(另带清零的 AV_INPUT_BUFFER_PADDING_SIZE 填充)的缓冲区, 失败返回 nullptr
+    AVBufferRef* get(size_t size)
+    {
+        requests.fetch_add(1, std::memory_order_relaxed);
+        AVBufferRef* buffer = nullptr;
+        auto iter = std::lower_bound(classes.begin(), classes.end(), size,
+            [](const SizeClass& sizeClass, size_t size) { return sizeClass.size < size; });
+        if (iter != classes.end()) {
+            buffer = av_buffer_pool_get(iter->handle);
+        } else {
+            oversize.fetch_add(1, std::memory_order_relaxed);
+            buffer = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        }
+
+        if (buffer == nullptr) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        memset(buffer->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        return buffer;
+    }
+
+    /// 把 buffer 的所有权交给 packet, 负载为前 size 字节; packet 原有数据会先被释放
+    static void attach(AVPacket* packet, AVBufferRef* buffer, size_t size)
+    {
+        av_packet_unref(packet);
+        packet->buf = buffer;
+        packet->data = buffer->data;
+        packet->size = static_cast<int>(size);
+    }
+
+    /// 为 packet 分配 capacity 字节的池化负载, 编码器写入 packet->data 后用 av_shrink_packet 修正实际大小
+    bool allocPacket(AVPacket* packet, size_t capacity)
+    {
+        AVBufferRef* buffer = get(capacity);
+        if (buffer == nullptr) {
+            return false;
+        }
+        attach(packet, buffer, capacity);
+        return true;
+    }
+
+    /// 拷贝一份 data 到池化缓冲区, 用于只能给出裸指针的上游; 能直接写入时应使用 allocPacket
+    bool fillPacket(AVPacket* packet, const uint8_t* data, size_t size)
+    {
+        if (!allocPacket(packet, size)) {
+            return false;
+        }
+        memcpy(packet->data, data, size);
+        return true;
+    }
+
+    std::vector<size_t> getSizeClasses() const
+    {
+        std::vector<size_t> sizes;
+        for (const auto& sizeClass : classes) {
+            sizes.push_back(sizeClass.size);
+        }
+        return sizes;
+    }
+
+    Statistic getStatistic() const
+    {
+        Statistic statistic;
+        statistic.requests = requests.load(std::memory_order_relaxed);
+        statistic.oversize = oversize.load(std::memory_order_relaxed);
+        statistic.failures = failures.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+private:
+    struct SizeClass {
+        size_t size;
+        AVBufferPool* handle;
+    };
+
+    std::vector<SizeClass> classes;
+    std::atomic<uint64_t> requests = 0;
+    std::atomic<uint64_t> oversize = 0;
+    std::atomic<uint64_t> failures = 0;
+};
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -11,9 +15,13 @@ extern "C" {
 #include "libavutil/opt.h"
 }
 
+#include "container/block_queue.hpp"
+#include "ffavio.hpp"
 #include "fferr.hpp"
 #include "ffinterrup_cb.hpp"
 #include "ffutil.hpp"
+#include "thread/thread_wrap.hpp"
+#include "time/time_utils.hpp"
 #include "xlog_common.hpp"
 
 class FFMuxer : public XLogLevelBase {
@@ -31,7 +39,7 @@ public:
 
         uint8_t* dumpExtradata() const
         {
-            return static_cast<uint8_t*>(av_memdup(extradata.data(), extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+            return FFMuxer::dumpExtradata(extradata);
         }
     };
 
@@ -44,14 +52,42 @@ public:
 
         uint8_t* dumpExtradata() const
         {
-            return static_cast<uint8_t*>(av_memdup(extradata.data(), extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+            return FFMuxer::dumpExtradata(extradata);
         }
     };
 
-    static std::shared_ptr<FFMuxer> Make(const std::string& outUrl, const VideoParams* vparams, const AudioParams* aparams)
+    /// 异步写模式的配置, 见 startAsync
+    struct AsyncOptions {
+        int queueSize = 64;
+        // 默认队列满时丢弃到下一个视频关键帧, 保证解码端不会花屏
+        xlab::QueueDropPolicy policy = xlab::QueueDropPolicy::DropUntilKey;
+        std::string threadName = "ffmuxer_writer";
+    };
+
+    struct AsyncStatistic {
+        size_t depth = 0;
+        size_t peakDepth = 0;
+        uint64_t written = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0; // 按丢弃策略丢掉的包
+        int64_t maxLatencyUs = 0; // 入队到写完的最大耗时
+    };
+
+    /// 拷贝 extradata 并在末尾补零填充, 原来直接 av_memdup(size + padding) 会越界读取
+    static uint8_t* dumpExtradata(const std::vector<uint8_t>& extradata)
+    {
+        auto data = static_cast<uint8_t*>(av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (data != nullptr && !extradata.empty()) {
+            memcpy(data, extradata.data(), extradata.size());
+        }
+        return data;
+    }
+
+    /// ioOptions 不为空且输出是本地文件时, 使用大缓冲区的自定义 AVIO 代替 avio_open2
+    static std::shared_ptr<FFMuxer> Make(const std::string& outUrl, const VideoParams* vparams, const AudioParams* aparams, const FFIOOptions* ioOptions = nullptr)
     {
         auto muxer = std::shared_ptr<FFMuxer>(new FFMuxer());
-        if (muxer->init(outUrl, vparams, aparams)) {
+        if (muxer->init(outUrl, vparams, aparams, ioOptions)) {
             return muxer;
         }
 
@@ -78,19 +114,103 @@ public:
         return (HandleType)(srt_socket);
     }
 
+    /// packet 的时间戳以 AV_TIME_BASE_Q 为单位. 同步模式下直接写出, 返回是否成功;
+    /// 异步模式下只引用(不拷贝)负载入队, 返回是否入队, 写出结果见 getAsyncStatistic 和 flush
     bool write(AVPacket* packet)
     {
-        av_packet_rescale_ts(packet, AV_TIME_BASE_Q, outFmtCtx->streams[packet->stream_index]->time_base);
-        const int write_result = av_write_frame(outFmtCtx, packet);
+        if (asyncQueue != nullptr) {
+            return enqueue(packet);
+        }
+        const int write_result = writePacket(packet);
         FF_SET_CODE(write_result);
-        return write_result < 0;
+        return write_result >= 0;
     }
 
+    /// 启动异步写模式, 此后 write 不会阻塞在网络 I/O 上; 只能在第一次 write 之前调用
+    bool startAsync()
+    {
+        return startAsync(AsyncOptions());
+    }
+
+    bool startAsync(const AsyncOptions& opts)
+    {
+        if (asyncQueue != nullptr || outFmtCtx == nullptr) {
+            return false;
+        }
+
+        const int videoIndex = videoStreamIndex;
+        asyncQueue = std::make_unique<AsyncQueue>(opts.queueSize, opts.policy, [videoIndex](const AsyncPacket& item) {
+            // 没有视频流时所有包都可以作为恢复点
+            return videoIndex < 0 || (item.packet->stream_index == videoIndex && (item.packet->flags & AV_PKT_FLAG_KEY));
+        });
+        asyncStop = false;
+        asyncThread = std::make_unique<ThreadWrap>(opts.threadName, [this]() { asyncLoop(); });
+        return true;
+    }
+
+    /// 等待已入队的包全部写出或被丢弃, 超时返回 false;
+    /// 写线程上一次 flush 以来最近的写出错误在这里转交给 getCode
+    bool flush(const xlab::Time::Interval& timeout)
+    {
+        if (asyncQueue == nullptr) {
+            return true;
+        }
+        bool drained = false;
+        {
+            std::unique_lock<std::mutex> locker(asyncMutex);
+            drained = asyncDrained.wait_for(locker, timeout.ToChrono<std::chrono::nanoseconds>(), [this]() {
+                return asyncInflight.load(std::memory_order_acquire) == 0;
+            });
+        }
+        const int async_code = asyncCode.exchange(0, std::memory_order_acq_rel);
+        if (async_code < 0) {
+            FF_SET_CODE_S(async_code, "av_write_frame");
+        }
+        return drained;
+    }
+
+    bool isAsync() const
+    {
+        return asyncQueue != nullptr;
+    }
+
+    AsyncStatistic getAsyncStatistic() const
+    {
+        AsyncStatistic statistic;
+        if (asyncQueue != nullptr) {
+            statistic.depth = asyncQueue->Size();
+            statistic.dropped = asyncQueue->GetDropStatistic().Total();
+        }
+        statistic.peakDepth = asyncPeakDepth.load(std::memory_order_relaxed);
+        statistic.written = asyncWritten.load(std::memory_order_relaxed);
+        statistic.failed = asyncFailed.load(std::memory_order_relaxed);
+        statistic.maxLatencyUs = asyncMaxLatencyUs.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+    void resetAsyncStatistic()
+    {
+        if (asyncQueue != nullptr) {
+            asyncQueue->ResetDropStatistic();
+        }
+        asyncPeakDepth = 0;
+        asyncWritten = 0;
+        asyncFailed = 0;
+        asyncMaxLatencyUs = 0;
+    }
+
+    /// 只能在调用 write 的线程读取; 异步模式下写线程的错误要经 flush 转交
     int getCode() const
     {
         return FF_GET_CODE();
     }
 
+    /// 写线程最近一次写出错误, 没有时为 0, 任意线程可读
+    int getAsyncCode() const
+    {
+        return asyncCode.load(std::memory_order_acquire);
+    }
+
     bool isExit() const
     {
         return interruptCB.IsExit();
@@ -102,7 +222,97 @@ public:
     }
 
 private:
-    bool init(const std::string& outUrl, const VideoParams* vparams, const AudioParams* aparams)
+    /// 队列中的包, 析构时(写完或被丢弃)减少在途计数, flush 据此判断是否排空
+    struct PacketRelease {
+        FFMuxer* muxer = nullptr;
+
+        void operator()(AVPacket* packet) const
+        {
+            av_packet_free(&packet);
+            if (muxer->asyncInflight.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> locker(muxer->asyncMutex);
+                muxer->asyncDrained.notify_all();
+            }
+        }
+    };
+
+    struct AsyncPacket {
+        std::unique_ptr<AVPacket, PacketRelease> packet;
+        xlab::Time::Point enqueueTime;
+    };
+
+    using AsyncQueue = xlab::BlockQueue<AsyncPacket>;
+
+    /// 不修改 code, 同步和异步两条路径各自在自己的线程记录结果
+    int writePacket(AVPacket* packet)
+    {
+        av_packet_rescale_ts(packet, AV_TIME_BASE_Q, outFmtCtx->streams[packet->stream_index]->time_base);
+        return av_write_frame(outFmtCtx, packet);
+    }
+
+    bool enqueue(const AVPacket* packet)
+    {
+        AVPacket* ref = av_packet_alloc();
+        if (ref == nullptr) {
+            FF_SET_CODE_S(AVERROR(ENOMEM), "av_packet_alloc");
+            return false;
+        }
+
+        asyncInflight.fetch_add(1, std::memory_order_acq_rel);
+        AsyncPacket item { std::unique_ptr<AVPacket, PacketRelease>(ref, PacketRelease { this }), xlab::Time::Point::Now() };
+        // 引用计数的负载只增加引用, 非引用计数的才会拷贝
+        const int ref_result = av_packet_ref(ref, packet);
+        if (ref_result < 0) {
+            FF_SET_CODE_S(ref_result, "av_packet_ref");
+            return false;
+        }
+
+        if (!asyncQueue->Push(std::move(item))) {
+            return false;
+        }
+
+        const size_t depth = asyncQueue->Size();
+        size_t peak = asyncPeakDepth.load(std::memory_order_relaxed);
+        while (depth > peak && !asyncPeakDepth.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) { }
+        return true;
+    }
+
+    void asyncLoop()
+    {
+        while (!asyncStop.load(std::memory_order_acquire)) {
+            auto item = asyncQueue->Pop();
+            if (!item.has_value()) {
+                continue;
+            }
+
+            // code 属于调用方线程, 写线程只记录到原子量里
+            const int write_result = writePacket(item->packet.get());
+            if (write_result >= 0) {
+                asyncWritten.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                asyncFailed.fetch_add(1, std::memory_order_relaxed);
+                asyncCode.store(write_result, std::memory_order_release);
+            }
+
+            const int64_t latency = (xlab::Time::Point::Now() - item->enqueueTime).RawValue<std::chrono::microseconds>();
+            int64_t maxLatency = asyncMaxLatencyUs.load(std::memory_order_relaxed);
+            while (latency > maxLatency && !asyncMaxLatencyUs.compare_exchange_weak(maxLatency, latency, std::memory_order_relaxed)) { }
+        }
+    }
+
+    /// 停止写线程, 未写出的包直接丢弃; 队列要在在途计数等成员之前销毁
+    void stopAsync()
+    {
+        if (asyncQueue == nullptr) {
+            return;
+        }
+        asyncStop = true;
+        asyncQueue->Pulse();
+        asyncThread.reset();
+        asyncQueue.reset();
+    }
+
+    bool init(const std::string& outUrl, const VideoParams* vparams, const AudioParams* aparams, const FFIOOptions* ioOptions)
     {
         const char* format_name;
         if (outUrl.find("srt://") != std::string::npos
@@ -141,7 +351,15 @@ private:
         }
 
         av_dump_format(outFmtCtx, 0, outUrl.c_str(), 1);
-        if (!(outFmtCtx->flags & AVFMT_NOFILE)) {
+        if (!(outFmtCtx->oformat->flags & AVFMT_NOFILE) && ioOptions != nullptr && FFIO::IsLocalFile(outUrl)) {
+            customIO = FFIO::OpenOutput(outUrl, *ioOptions);
+            if (customIO == nullptr) {
+                FF_SET_CODE_S(AVERROR(errno), "FFIO::OpenOutput");
+                return false;
+            }
+            outFmtCtx->pb = customIO->get();
+            ioOpenResult = 0;
+        } else if (!(outFmtCtx->flags & AVFMT_NOFILE)) {
             ioOpenResult = avio_open2(&outFmtCtx->pb, outUrl.c_str(), AVIO_FLAG_WRITE, &outFmtCtx->interrupt_callback, &options);
             if (ioOpenResult < 0) {
                 FF_SET_CODE_S(ioOpenResult, "avio_open2");
@@ -161,12 +379,16 @@ private:
     void deInit()
     {
         requestExit();
+        stopAsync();
         if (outFmtCtx != nullptr) {
             if (ioOpenResult >= 0) {
                 av_write_trailer(outFmtCtx);
             }
 
-            if ((outFmtCtx->pb != nullptr) && !(outFmtCtx->flags & AVFMT_NOFILE) && (ioOpenResult >= 0)) {
+            if (customIO != nullptr) {
+                outFmtCtx->pb = nullptr;
+                customIO.reset();
+            } else if ((outFmtCtx->pb != nullptr) && !(outFmtCtx->flags & AVFMT_NOFILE) && (ioOpenResult >= 0)) {
                 avio_closep(&outFmtCtx->pb);
             }
 
@@ -226,6 +448,7 @@ private:
         stream->r_frame_rate = stream->avg_frame_rate;
 
         videoCodecCtx = codecCtx;
+        videoStreamIndex = stream->index;
         return true;
     }
 
@@ -284,4 +507,18 @@ private:
     AVDictionary* options = nullptr;
     int ioOpenResult = -1;
     int ioWriteHeadResult = -1;
+    int videoStreamIndex = -1;
+    std::unique_ptr<FFIOBase> customIO;
+
+    std::unique_ptr<AsyncQueue> asyncQueue;
+    std::unique_ptr<ThreadWrap> asyncThread;
+    std::atomic<bool> asyncStop = false;
+    std::atomic<size_t> asyncInflight = 0;
+    std::mutex asyncMutex;
+    std::condition_variable asyncDrained;
+    std::atomic<size_t> asyncPeakDepth = 0;
+    std::atomic<uint64_t> asyncWritten = 0;
+    std::atomic<uint64_t> asyncFailed = 0;
+    std::atomic<int64_t> asyncMaxLatencyUs = 0;
+    std::atomic<int> asyncCode = 0;
 };
@@ -18,12 +18,17 @@ struct FFPacket : public XLogLevelBase {
         handle_ = av_packet_alloc();
     }
 
-    explicit FFPacket(const AVPacket* pkt)
-        : handle_(pkt)
-        , XLogLevelBase()
+    /// 接管 pkt 的所有权, 析构时释放
+    explicit FFPacket(AVPacket* pkt)
+        : XLogLevelBase()
+        , handle_(pkt)
     {
     }
 
+    FFPacket(const FFPacket&) = delete;
+
+    FFPacket& operator=(const FFPacket&) = delete;
+
     ~FFPacket()
     {
         av_packet_free(&handle_);
@@ -36,12 +41,23 @@ struct FFPacket : public XLogLevelBase {
 
     bool isKey() const
     {
-        return (handle_->flags | AV_PKT_FLAG_KEY) == AV_PKT_FLAG_KEY;
+        return (handle_->flags & AV_PKT_FLAG_KEY) != 0;
+    }
+
+    void apply(const DoType& func)
+    {
+        func(handle_);
+    }
+
+    AVPacket* get() const
+    {
+        return handle_;
     }
 
-    void do(const DoType& func)
+    /// 释放引用的数据, 保留结构体本身以便复用
+    void unref()
     {
-        func(handle_)
+        av_packet_unref(handle_);
     }
 
     void log(const AVFormatContext* fmt_ctx)
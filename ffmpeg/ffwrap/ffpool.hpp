@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ffpacket.hpp"
+#include "fframe.hpp"
+
+/// 复用 FFPacket/FFrame 的对象池, 避免每帧 av_packet_alloc/av_frame_alloc 的分配开销;
+/// acquire 返回的句柄析构时先 unref 再归还池中, 池已销毁时直接释放; 空闲对象超过 capacity 时直接释放
+template <typename T>
+class FFPool : public std::enable_shared_from_this<FFPool<T>> {
+public:
+    struct Statistic {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t recycles = 0;
+        uint64_t drops = 0;
+    };
+
+    class Recycler {
+    public:
+        Recycler() = default;
+
+        explicit Recycler(std::weak_ptr<FFPool> pool)
+            : pool_(std::move(pool))
+        {
+        }
+
+        void operator()(T* object) const
+        {
+            if (auto pool = pool_.lock()) {
+                pool->recycle(object);
+            } else {
+                delete object;
+            }
+        }
+
+    private:
+        std::weak_ptr<FFPool> pool_;
+    };
+
+    using Handle = std::unique_ptr<T, Recycler>;
+
+    static std::shared_ptr<FFPool> Make(size_t capacity = 64, size_t prealloc = 0)
+    {
+        auto pool = std::shared_ptr<FFPool>(new FFPool(capacity));
+        pool->idle.reserve(capacity);
+        for (size_t i = 0; i < prealloc && i < capacity; i++) {
+            pool->idle.emplace_back(new T());
+        }
+        return pool;
+    }
+
+private:
+    explicit FFPool(size_t capacity)
+        : capacity(capacity)
+    {
+    }
+
+public:
+    Handle acquire()
+    {
+        std::unique_ptr<T> object;
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            if (!idle.empty()) {
+                object = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+
+        if (object != nullptr) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            object.reset(new T());
+        }
+        return Handle(object.release(), Recycler(this->weak_from_this()));
+    }
+
+    size_t getIdleSize()
+    {
+        std::lock_guard<std::mutex> locker(mutex);
+        return idle.size();
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    Statistic getStatistic() const
+    {
+        Statistic statistic;
+        statistic.hits = hits.load(std::memory_order_relaxed);
+        statistic.misses = misses.load(std::memory_order_relaxed);
+        statistic.recycles = recycles.load(std::memory_order_relaxed);
+        statistic.drops = drops.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+    void resetStatistic()
+    {
+        hits.store(0, std::memory_order_relaxed);
+        misses.store(0, std::memory_order_relaxed);
+        recycles.store(0, std::memory_order_relaxed);
+        drops.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    void recycle(T* object)
+    {
+        // unref 会释放引用的数据, 放在锁外做
+        object->unref();
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            if (idle.size() < capacity) {
+                idle.emplace_back(object);
+                recycles.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        drops.fetch_add(1, std::memory_order_relaxed);
+        delete object;
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T>> idle;
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> misses = 0;
+    std::atomic<uint64_t> recycles = 0;
+    std::atomic<uint64_t> drops = 0;
+};
+
+using PacketPool = FFPool<FFPacket>;
+using FramePool = FFPool<FFrame>;
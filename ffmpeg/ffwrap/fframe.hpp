@@ -18,12 +18,17 @@ struct FFrame : public XLogLevelBase {
         handle_ = av_frame_alloc();
     }
 
-    explicit FFrame(const AVFrame* frame)
-        : handle_(frame)
-        , XLogLevelBase()
+    /// 接管 frame 的所有权, 析构时释放
+    explicit FFrame(AVFrame* frame)
+        : XLogLevelBase()
+        , handle_(frame)
     {
     }
 
+    FFrame(const FFrame&) = delete;
+
+    FFrame& operator=(const FFrame&) = delete;
+
     ~FFrame()
     {
         av_frame_free(&handle_);
@@ -34,11 +39,22 @@ struct FFrame : public XLogLevelBase {
         return handle_ == nullptr || handle_->data[0] == nullptr || handle_->linesize[0] == 0;
     }
 
-    void do(const DoType& func)
+    void apply(const DoType& func)
     {
         func(handle_);
     }
 
+    AVFrame* get() const
+    {
+        return handle_;
+    }
+
+    /// 释放引用的数据, 保留结构体本身以便复用
+    void unref()
+    {
+        av_frame_unref(handle_);
+    }
+
     void log()
     {
         dlog("width:{}, height:{},key_frame:{},pict_type:{},format:{},pts:{},pkt_dts:{},nb_samples:{},sample_rate:{}",
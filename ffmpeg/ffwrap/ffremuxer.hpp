@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -11,15 +12,37 @@ extern "C" {
 #include "libavutil/opt.h"
 }
 
+#include "container/block_queue.hpp"
+#include "ffavio.hpp"
 #include "fferr.hpp"
 #include "ffinterrup_cb.hpp"
 #include "ffutil.hpp"
+#include "thread/thread_wrap.hpp"
+#include "time/time_utils.hpp"
 #include "xlog_common.hpp"
 
 class FFRemuxer : public XLogLevelBase {
 public:
     using HandleType = int;
 
+    struct RunOptions {
+        int queueSize = 256;
+    };
+
+    struct StageStatistic {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        int64_t totalUs = 0; // 阶段内 I/O 调用的累计耗时
+        int64_t maxUs = 0;
+    };
+
+    struct RunStatistic {
+        StageStatistic read;
+        StageStatistic write;
+        size_t peakDepth = 0;
+        int64_t maxQueueUs = 0; // 包在队列中的最长停留时间
+    };
+
 private:
     explicit FFRemuxer()
         : XLogLevelBase()
@@ -27,10 +50,11 @@ private:
     }
 
 public:
-    static std::shared_ptr<FFRemuxer> Make(const std::string& inUrl, const std::string& outUrl)
+    /// ioOptions 不为空时, 本地文件的输入/输出使用大缓冲区的自定义 AVIO(输入带预读线程)
+    static std::shared_ptr<FFRemuxer> Make(const std::string& inUrl, const std::string& outUrl, const FFIOOptions* ioOptions = nullptr)
     {
         auto muxer = std::shared_ptr<FFRemuxer>(new FFRemuxer());
-        if (muxer->init(inUrl, outUrl)) {
+        if (muxer->init(inUrl, outUrl, ioOptions)) {
             return muxer;
         }
 
@@ -50,6 +74,7 @@ public:
         return (HandleType)(srt_socket);
     }
 
+    /// 成功返回 true; 不需要输出的流的包会被丢弃并返回 false
     bool read(AVPacket* packet, const AVRational* timebase = nullptr)
     {
         const int read_result = av_read_frame(inFmtCtx, packet);
@@ -58,20 +83,22 @@ public:
             return false;
         }
 
-        if (packet->stream_index >= streamMapping.size() || streamMapping[packet->stream_index] < 0) {
+        const int inIndex = packet->stream_index;
+        if (inIndex >= streamMapping.size() || streamMapping[inIndex] < 0) {
             av_packet_unref(packet);
             FF_SET_CODE_S(read_result, "stream_index >= nb_stream");
             return false;
         }
 
-        packet->stream_index = streamMapping[packet->stream_index];
+        packet->stream_index = streamMapping[inIndex];
         if (timebase != nullptr) {
-            av_packet_rescale_ts(packet, inFmtCtx->streams[packet->stream_index]->time_base, *timebase);
+            av_packet_rescale_ts(packet, inFmtCtx->streams[inIndex]->time_base, *timebase);
         }
 
-        return read_result < 0;
+        return true;
     }
 
+    /// 成功返回 true
     bool write(AVPacket* packet, const AVRational* timebase = nullptr)
     {
         if (timebase != nullptr) {
@@ -80,7 +107,55 @@ public:
 
         const int write_result = av_interleaved_write_frame(outFmtCtx, packet);
         FF_SET_CODE(write_result);
-        return write_result < 0;
+        return write_result >= 0;
+    }
+
+    /// 读写流水线: 读线程 av_read_frame 入有界队列, 写线程 av_interleaved_write_frame 写出,
+    /// 两端的 I/O 延迟不再串行叠加. 阻塞到输入结束, requestExit 或出错, 返回 0 或 AVERROR
+    int run()
+    {
+        return run(RunOptions());
+    }
+
+    int run(const RunOptions& opts)
+    {
+        resetRunStatistic();
+        PacketQueue queue(opts.queueSize);
+        std::atomic<int> readResult = 0;
+        std::atomic<int> writeResult = 0;
+        {
+            ThreadWrap reader("ffremux_reader", [&]() { readResult = readLoop(queue); });
+            ThreadWrap writer("ffremux_writer", [&]() { writeResult = writeLoop(queue); });
+        }
+
+        // 输入正常结束视为成功, 写端的错误优先上报
+        int result = writeResult != 0 ? writeResult.load() : readResult.load();
+        if (result == AVERROR_EOF) {
+            result = 0;
+        }
+        FF_SET_CODE_S(result, "run");
+        return result;
+    }
+
+    /// 未使用自定义 AVIO 时返回全零
+    FFIOBase::Statistic getInputIOStatistic() const
+    {
+        return inputIO != nullptr ? inputIO->getStatistic() : FFIOBase::Statistic();
+    }
+
+    FFIOBase::Statistic getOutputIOStatistic() const
+    {
+        return outputIO != nullptr ? outputIO->getStatistic() : FFIOBase::Statistic();
+    }
+
+    RunStatistic getRunStatistic() const
+    {
+        RunStatistic statistic;
+        statistic.read = readStatistic.Load();
+        statistic.write = writeStatistic.Load();
+        statistic.peakDepth = peakDepth.load(std::memory_order_relaxed);
+        statistic.maxQueueUs = maxQueueUs.load(std::memory_order_relaxed);
+        return statistic;
     }
 
     int getCode() const
@@ -99,14 +174,145 @@ public:
     }
 
 private:
-    bool init(const std::string& inUrl, const std::string& outUrl)
+    struct PacketFree {
+        void operator()(AVPacket* packet) const
+        {
+            av_packet_free(&packet);
+        }
+    };
+
+    /// packet 为空表示输入结束
+    struct QueueItem {
+        std::unique_ptr<AVPacket, PacketFree> packet;
+        xlab::Time::Point enqueueTime;
+    };
+
+    using PacketQueue = xlab::BlockQueue<QueueItem>;
+
+    struct AtomicStageStatistic {
+        std::atomic<uint64_t> packets = 0;
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<int64_t> totalUs = 0;
+        std::atomic<int64_t> maxUs = 0;
+
+        void Add(int size, int64_t costUs)
+        {
+            packets.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(size, std::memory_order_relaxed);
+            totalUs.fetch_add(costUs, std::memory_order_relaxed);
+            UpdateMax(maxUs, costUs);
+        }
+
+        StageStatistic Load() const
+        {
+            StageStatistic statistic;
+            statistic.packets = packets.load(std::memory_order_relaxed);
+            statistic.bytes = bytes.load(std::memory_order_relaxed);
+            statistic.totalUs = totalUs.load(std::memory_order_relaxed);
+            statistic.maxUs = maxUs.load(std::memory_order_relaxed);
+            return statistic;
+        }
+
+        void Reset()
+        {
+            packets = 0;
+            bytes = 0;
+            totalUs = 0;
+            maxUs = 0;
+        }
+    };
+
+    template <typename T>
+    static void UpdateMax(std::atomic<T>& target, T value)
+    {
+        T current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    }
+
+    static int64_t ElapsedUs(const xlab::Time::Point& since)
+    {
+        return (xlab::Time::Point::Now() - since).RawValue<std::chrono::microseconds>();
+    }
+
+    void resetRunStatistic()
+    {
+        readStatistic.Reset();
+        writeStatistic.Reset();
+        peakDepth = 0;
+        maxQueueUs = 0;
+    }
+
+    int readLoop(PacketQueue& queue)
+    {
+        int result = 0;
+        while (!isExit()) {
+            std::unique_ptr<AVPacket, PacketFree> packet(av_packet_alloc());
+            if (packet == nullptr) {
+                result = AVERROR(ENOMEM);
+                break;
+            }
+
+            const auto begin = xlab::Time::Point::Now();
+            result = av_read_frame(inFmtCtx, packet.get());
+            if (result < 0) {
+                break;
+            }
+            readStatistic.Add(packet->size, ElapsedUs(begin));
+
+            const int inIndex = packet->stream_index;
+            if (inIndex >= streamMapping.size() || streamMapping[inIndex] < 0) {
+                continue;
+            }
+            packet->stream_index = streamMapping[inIndex];
+            av_packet_rescale_ts(packet.get(), inFmtCtx->streams[inIndex]->time_base, outFmtCtx->streams[packet->stream_index]->time_base);
+            packet->pos = -1;
+
+            queue.Push(QueueItem { std::move(packet), xlab::Time::Point::Now() });
+            UpdateMax(peakDepth, queue.Size());
+        }
+
+        queue.Push(QueueItem { nullptr, xlab::Time::Point::Now() });
+        return result;
+    }
+
+    int writeLoop(PacketQueue& queue)
+    {
+        int result = 0;
+        while (true) {
+            auto item = queue.Pop();
+            if (!item.has_value()) {
+                continue;
+            }
+            if (item->packet == nullptr) {
+                break;
+            }
+            if (result < 0) {
+                continue;
+            }
+
+            UpdateMax(maxQueueUs, ElapsedUs(item->enqueueTime));
+            const int size = item->packet->size;
+            const auto begin = xlab::Time::Point::Now();
+            result = av_interleaved_write_frame(outFmtCtx, item->packet.get());
+            if (result < 0) {
+                // 让读线程尽快退出, 清空队列以解除它在 Push 上的阻塞, 之后等待它的结束标记
+                requestExit();
+                queue.Clear();
+                continue;
+            }
+            writeStatistic.Add(size, ElapsedUs(begin));
+        }
+        return result;
+    }
+
+    bool init(const std::string& inUrl, const std::string& outUrl, const FFIOOptions* ioOptions)
     {
-        if (!initInFormatCtx(inUrl)) {
+        if (!initInFormatCtx(inUrl, ioOptions)) {
             deInit();
             return false;
         }
 
-        if (!initOutFormatCtx(outUrl)) {
+        if (!initOutFormatCtx(outUrl, ioOptions)) {
             deInit();
             return false;
         }
@@ -122,7 +328,7 @@ private:
         av_dict_free(&options);
     }
 
-    bool initInFormatCtx(const std::string& inUrl)
+    bool initInFormatCtx(const std::string& inUrl, const FFIOOptions* ioOptions)
     {
         inFmtCtx = avformat_alloc_context();
         if (inFmtCtx == nullptr) {
@@ -131,6 +337,16 @@ private:
         }
 
         inFmtCtx->interrupt_callback = interruptCB.GetAVIOInterruptCB();
+        if (ioOptions != nullptr && FFIO::IsLocalFile(inUrl)) {
+            inputIO = FFIO::OpenInput(inUrl, *ioOptions);
+            if (inputIO == nullptr) {
+                FF_SET_CODE_S(AVERROR(errno), "FFIO::OpenInput");
+                return false;
+            }
+            inFmtCtx->pb = inputIO->get();
+            inFmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+
         int result = avformat_open_input(&inFmtCtx, inUrl.c_str(), nullptr, &options);
         if (result < 0) {
             FF_SET_CODE_S(result, "avformat_open_input");
@@ -158,10 +374,12 @@ private:
 
     void deInitInFormatCtx()
     {
+        // 自定义 AVIO 不会被 avformat_close_input 释放
         avformat_close_input(&inFmtCtx);
+        inputIO.reset();
     }
 
-    bool initOutFormatCtx(const std::string& outUrl)
+    bool initOutFormatCtx(const std::string& outUrl, const FFIOOptions* ioOptions)
     {
         const char* format_name;
         if (outUrl.find("srt://") != std::string::npos
@@ -220,7 +438,15 @@ private:
         }
 
         av_dump_format(outFmtCtx, 0, outUrl.c_str(), 1);
-        if (!(outFmtCtx->flags & AVFMT_NOFILE)) {
+        if (!(outFmtCtx->oformat->flags & AVFMT_NOFILE) && ioOptions != nullptr && FFIO::IsLocalFile(outUrl)) {
+            outputIO = FFIO::OpenOutput(outUrl, *ioOptions);
+            if (outputIO == nullptr) {
+                FF_SET_CODE_S(AVERROR(errno), "FFIO::OpenOutput");
+                return false;
+            }
+            outFmtCtx->pb = outputIO->get();
+            ioOpenResult = 0;
+        } else if (!(outFmtCtx->flags & AVFMT_NOFILE)) {
             ioOpenResult = avio_open2(&outFmtCtx->pb, outUrl.c_str(), AVIO_FLAG_WRITE, &outFmtCtx->interrupt_callback, &options);
             if (ioOpenResult < 0) {
                 FF_SET_CODE_S(ioOpenResult, "avio_open2");
@@ -244,7 +470,10 @@ private:
                 av_write_trailer(outFmtCtx);
             }
 
-            if ((outFmtCtx->pb != nullptr) && !(outFmtCtx->flags & AVFMT_NOFILE) && (ioOpenResult >= 0)) {
+            if (outputIO != nullptr) {
+                outFmtCtx->pb = nullptr;
+                outputIO.reset();
+            } else if ((outFmtCtx->pb != nullptr) && !(outFmtCtx->flags & AVFMT_NOFILE) && (ioOpenResult >= 0)) {
                 avio_closep(&outFmtCtx->pb);
             }
 
@@ -262,4 +491,11 @@ private:
     AVDictionary* options = nullptr;
     AVFormatContext* inFmtCtx = nullptr;
     AVFormatContext* outFmtCtx = nullptr;
+    std::unique_ptr<FFIOBase> inputIO;
+    std::unique_ptr<FFIOBase> outputIO;
+
+    AtomicStageStatistic readStatistic;
+    AtomicStageStatistic writeStatistic;
+    std::atomic<size_t> peakDepth = 0;
+    std::atomic<int64_t> maxQueueUs = 0;
 };
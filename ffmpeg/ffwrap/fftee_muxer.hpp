@@ -0,0 +1,279 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ffmuxer.hpp"
+#include "thread/thread_wrap.hpp"
+#include "time/time_utils.hpp"
+#include "xlog_common.hpp"
+
+/// 同一路编码流同时推到多个目的地(SRT/本地录制/RTP 监看等):
+/// 每个输出是一个异步模式的 FFMuxer, 有独立的写线程和队列, write 只对负载增加引用不拷贝,
+/// 慢的输出只会在自己的队列里丢包, 不会拖住其他输出; 写失败的输出由后台线程按间隔重连,
+/// 重连后丢弃到下一个视频关键帧再恢复写入
+class FFTeeMuxer : public XLogLevelBase {
+public:
+    struct SinkOptions {
+        std::string url;
+        FFMuxer::AsyncOptions async;
+        xlab::Time::Interval reconnectInterval = xlab::Time::Interval(std::chrono::seconds(2));
+    };
+
+    struct SinkStatistic {
+        std::string url;
+        bool connected = false;
+        uint64_t reconnects = 0;
+        uint64_t skippedBeforeKey = 0;
+        FFMuxer::AsyncStatistic async;
+    };
+
+    /// 至少有一个输出连接成功时返回实例, 连接失败的输出由后台线程继续重连
+    static std::shared_ptr<FFTeeMuxer> Make(const std::vector<SinkOptions>& sinks, const FFMuxer::VideoParams* vparams, const FFMuxer::AudioParams* aparams)
+    {
+        auto tee = std::shared_ptr<FFTeeMuxer>(new FFTeeMuxer(vparams, aparams));
+        size_t connected = 0;
+        for (const auto& options : sinks) {
+            auto sink = std::make_unique<Sink>();
+            sink->options = options;
+            if (tee->connect(*sink)) {
+                connected += 1;
+            }
+            tee->sinks.push_back(std::move(sink));
+        }
+
+        if (connected == 0) {
+            lllog(tee->getConsoleLevel(), tee->getTextLevel(), "all {} sinks failed to open", sinks.size());
+            return nullptr;
+        }
+
+        tee->supervisor = std::make_unique<ThreadWrap>("fftee_reconnect", [thiz = tee.get()]() { thiz->supervise(); });
+        return tee;
+    }
+
+private:
+    explicit FFTeeMuxer(const FFMuxer::VideoParams* vparams, const FFMuxer::AudioParams* aparams)
+        : XLogLevelBase()
+    {
+        if (vparams != nullptr) {
+            videoParams = *vparams;
+        }
+        if (aparams != nullptr) {
+            audioParams = *aparams;
+        }
+    }
+
+public:
+    ~FFTeeMuxer()
+    {
+        requestExit();
+        supervisor.reset();
+        for (auto& sink : sinks) {
+            std::shared_ptr<FFMuxer> muxer;
+            {
+                std::lock_guard<std::mutex> locker(sink->mutex);
+                muxer = std::move(sink->muxer);
+            }
+            if (muxer != nullptr) {
+                muxer->requestExit();
+            }
+        }
+    }
+
+    /// packet 的时间戳以 AV_TIME_BASE_Q 为单位, 调用后 packet 保持不变; 返回是否至少有一个输出接收
+    bool write(const AVPacket* packet)
+    {
+        bool accepted = false;
+        for (auto& sink : sinks) {
+            auto muxer = sink->get();
+            if (muxer == nullptr) {
+                continue;
+            }
+
+            if (sink->waitKey.load(std::memory_order_acquire)) {
+                if (packet->stream_index != videoStreamIndex() || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                    sink->skippedBeforeKey.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                sink->waitKey.store(false, std::memory_order_release);
+            }
+
+            // 异步模式下 FFMuxer::write 只引用 packet, 不修改调用方的时间戳
+            accepted |= muxer->write(const_cast<AVPacket*>(packet));
+        }
+        return accepted;
+    }
+
+    /// 等待所有输出排空, 任一输出超时返回 false
+    bool flush(const xlab::Time::Interval& timeout)
+    {
+        bool drained = true;
+        for (auto& sink : sinks) {
+            auto muxer = sink->get();
+            if (muxer != nullptr) {
+                drained &= muxer->flush(timeout);
+            }
+        }
+        return drained;
+    }
+
+    size_t getSinkCount() const
+    {
+        return sinks.size();
+    }
+
+    SinkStatistic getSinkStatistic(size_t index) const
+    {
+        SinkStatistic statistic;
+        if (index >= sinks.size()) {
+            return statistic;
+        }
+
+        const auto& sink = sinks[index];
+        auto muxer = sink->get();
+        statistic.url = sink->options.url;
+        statistic.connected = muxer != nullptr;
+        statistic.reconnects = sink->reconnects.load(std::memory_order_relaxed);
+        statistic.skippedBeforeKey = sink->skippedBeforeKey.load(std::memory_order_relaxed);
+        if (muxer != nullptr) {
+            statistic.async = muxer->getAsyncStatistic();
+        }
+        return statistic;
+    }
+
+    bool isExit() const
+    {
+        return exiting.load(std::memory_order_acquire);
+    }
+
+    void requestExit()
+    {
+        {
+            std::lock_guard<std::mutex> locker(exitMutex);
+            exiting = true;
+        }
+        exitCond.notify_all();
+    }
+
+private:
+    struct Sink {
+        SinkOptions options;
+        mutable std::mutex mutex;
+        std::shared_ptr<FFMuxer> muxer;
+        std::atomic<bool> waitKey = false;
+        std::atomic<uint64_t> reconnects = 0;
+        std::atomic<uint64_t> skippedBeforeKey = 0;
+        // 上次检查时的计数, 只由重连线程访问
+        uint64_t lastWritten = 0;
+        uint64_t lastFailed = 0;
+        xlab::Time::Point lastAttempt = xlab::Time::Point::Now();
+
+        std::shared_ptr<FFMuxer> get() const
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            return muxer;
+        }
+    };
+
+    int videoStreamIndex() const
+    {
+        // FFMuxer 总是先建视频流
+        return videoParams.has_value() ? 0 : -1;
+    }
+
+    bool connect(Sink& sink)
+    {
+        sink.lastAttempt = xlab::Time::Point::Now();
+        auto muxer = FFMuxer::Make(sink.options.url,
+            videoParams.has_value() ? &videoParams.value() : nullptr,
+            audioParams.has_value() ? &audioParams.value() : nullptr);
+        if (muxer == nullptr || !muxer->startAsync(sink.options.async)) {
+            return false;
+        }
+
+        sink.lastWritten = 0;
+        sink.lastFailed = 0;
+        sink.waitKey.store(videoParams.has_value(), std::memory_order_release);
+        std::lock_guard<std::mutex> locker(sink.mutex);
+        sink.muxer = std::move(muxer);
+        return true;
+    }
+
+    /// 一个检查周期内只有失败没有成功的输出视为断开
+    bool isBroken(Sink& sink, const std::shared_ptr<FFMuxer>& muxer)
+    {
+        const auto statistic = muxer->getAsyncStatistic();
+        const bool broken = statistic.failed > sink.lastFailed && statistic.written == sink.lastWritten;
+        sink.lastWritten = statistic.written;
+        sink.lastFailed = statistic.failed;
+        return broken;
+    }
+
+    void supervise()
+    {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> locker(exitMutex);
+                exitCond.wait_for(locker, std::chrono::milliseconds(500), [this]() { return isExit(); });
+                if (isExit()) {
+                    return;
+                }
+            }
+
+            releaseRetired();
+            for (auto& sink : sinks) {
+                auto muxer = sink->get();
+                if (muxer != nullptr) {
+                    if (!isBroken(*sink, muxer)) {
+                        continue;
+                    }
+                    lllog(getConsoleLevel(), getTextLevel(), "sink {} broken, reconnecting", sink->options.url);
+                    {
+                        std::lock_guard<std::mutex> locker(sink->mutex);
+                        sink->muxer.reset();
+                    }
+                    muxer->requestExit();
+                    retired.push_back(std::move(muxer));
+                    sink->lastAttempt = xlab::Time::Point::Now() - sink->options.reconnectInterval;
+                }
+
+                if (isExit() || xlab::Time::Point::Now() - sink->lastAttempt < sink->options.reconnectInterval) {
+                    continue;
+                }
+
+                if (connect(*sink)) {
+                    sink->reconnects.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    /// 断开的 FFMuxer 析构时要等写线程退出并写 trailer; write/flush 可能还拿着它的引用,
+    /// 若在那些线程释放最后一个引用, 编码线程就会被阻塞. 所以先放进 retired,
+    /// 等只剩这里的引用后由重连线程析构. sink 已置空, 引用计数不会再增加
+    void releaseRetired()
+    {
+        for (auto iter = retired.begin(); iter != retired.end();) {
+            if (iter->use_count() == 1) {
+                iter = retired.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+private:
+    std::optional<FFMuxer::VideoParams> videoParams;
+    std::optional<FFMuxer::AudioParams> audioParams;
+    std::vector<std::unique_ptr<Sink>> sinks;
+    std::vector<std::shared_ptr<FFMuxer>> retired; // 只由重连线程访问, 见 releaseRetired
+    std::unique_ptr<ThreadWrap> supervisor;
+    std::mutex exitMutex;
+    std::condition_variable exitCond;
+    std::atomic<bool> exiting = false;
+};
@@ -0,0 +1,636 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "common/windowed_filter.hpp"
+#include "xlog_common.hpp"
+
+/// SRT live 模式单包负载, 188 * 7 字节的 TS 包
+inline constexpr int64_t SRT_LIVE_PAYLOAD_SIZE = 1316;
+
+/// 一次传输统计采样, 与具体传输协议无关; 计数类字段都是距上次采样的增量
+struct TransportStats {
+    int64_t nowMs = 0; // 采样时刻, 由调用方的单调时钟给出, 控制器内部不读时钟
+    int rttMs = 0;
+    int64_t sendRateBps = 0; // bits/s
+    int64_t inflightBytes = 0;
+    int64_t pktSent = 0;
+    int64_t pktLoss = 0;
+    int64_t pktRetrans = 0;
+    int64_t pktSndDrop = 0; // 超过延迟被发送端丢弃的包
+    int sndBufMs = 0; // 发送缓冲中数据覆盖的时长
+    int64_t sndBufBytes = 0;
+    int64_t availSndBufBytes = 0;
+};
+
+/// 由 TransportStats 派生的拥塞信号, 也直接给监控面板展示
+struct CongestionSignals {
+    enum class Level {
+        None,
+        Early, // 开始排队, 停止上调
+        Severe, // 已丢包或发送缓冲积压, 立即下调
+    };
+
+    int64_t nowMs = 0;
+    double lossRate = 0; // 平滑后的 pktSndLoss / pktSent
+    double retransRate = 0; // 平滑后的 pktRetrans / pktSent
+    int64_t sndDrop = 0;
+    int sndBufMs = 0;
+    int64_t sndBufBytes = 0;
+    double sndBufOccupancy = 0; // 发送缓冲占用比例
+    double sndBufTrendMs = 0; // 发送缓冲时长每个采样的平滑增量, 正值表示在积压
+    Level level = Level::None;
+};
+
+/// 丢包/重传/发送缓冲信号检测: 发送缓冲持续增长早于 RTT 上升和丢包出现, 作为提前降码率的依据
+class CongestionSignalDetector final {
+public:
+    struct Thresholds {
+        double earlyLossRate = 0.02;
+        double severeLossRate = 0.10;
+        double earlyRetransRate = 0.05;
+        double earlySndBufTrendMs = 20;
+        double earlySndBufRttRatio = 2; // 发送缓冲时长超过 RTT 的倍数才认为增长是积压
+        int severeSndBufMs = 500;
+        double severeSndBufOccupancy = 0.5;
+    };
+
+    const CongestionSignals& update(const TransportStats& stats)
+    {
+        const double sent = static_cast<double>(std::max<int64_t>(stats.pktSent, 1));
+        signals.nowMs = stats.nowMs;
+        signals.lossRate = loss_rate.Update(std::min(stats.pktLoss / sent, 1.0));
+        signals.retransRate = retrans_rate.Update(std::min(stats.pktRetrans / sent, 1.0));
+        signals.sndDrop = stats.pktSndDrop;
+        signals.sndBufTrendMs = last_snd_buf_ms >= 0 ? snd_buf_trend.Update(stats.sndBufMs - last_snd_buf_ms) : 0;
+        last_snd_buf_ms = stats.sndBufMs;
+        signals.sndBufMs = stats.sndBufMs;
+        signals.sndBufBytes = stats.sndBufBytes;
+        const int64_t capacity = stats.sndBufBytes + stats.availSndBufBytes;
+        signals.sndBufOccupancy = capacity > 0 ? static_cast<double>(stats.sndBufBytes) / capacity : 0;
+
+        const bool backlog = stats.sndBufMs > stats.rttMs * thresholds.earlySndBufRttRatio;
+        if (signals.sndDrop > 0
+            || signals.lossRate > thresholds.severeLossRate
+            || (backlog && stats.sndBufMs > thresholds.severeSndBufMs)
+            || signals.sndBufOccupancy > thresholds.severeSndBufOccupancy) {
+            signals.level = CongestionSignals::Level::Severe;
+        } else if (signals.lossRate > thresholds.earlyLossRate
+            || signals.retransRate > thresholds.earlyRetransRate
+            || (backlog && signals.sndBufTrendMs > thresholds.earlySndBufTrendMs)) {
+            signals.level = CongestionSignals::Level::Early;
+        } else {
+            signals.level = CongestionSignals::Level::None;
+        }
+        return signals;
+    }
+
+    const CongestionSignals& getSignals() const
+    {
+        return signals;
+    }
+
+    void setThresholds(const Thresholds& value)
+    {
+        thresholds = value;
+    }
+
+    void reset()
+    {
+        loss_rate.Reset();
+        retrans_rate.Reset();
+        snd_buf_trend.Reset();
+        last_snd_buf_ms = -1;
+        signals = CongestionSignals();
+    }
+
+private:
+    Thresholds thresholds;
+    CongestionSignals signals;
+    xlab::Ewma loss_rate { 0.3 };
+    xlab::Ewma retrans_rate { 0.3 };
+    xlab::Ewma snd_buf_trend { 0.5 };
+    int last_snd_buf_ms = -1;
+};
+
+/// 码率控制器: 周期性喂入 TransportStats, 编码线程按自己的节奏取目标码率;
+/// 每个采样先经过 CongestionSignalDetector, 各算法结合信号等级决定升降. 实现不加锁, 由持有者保证串行调用
+class BitrateController : public XLogLevelBase {
+public:
+    enum class Algorithm {
+        Heuristic,
+        BBR,
+        GCC,
+    };
+
+    static std::unique_ptr<BitrateController> Make(Algorithm algorithm);
+
+    virtual ~BitrateController() = default;
+
+    virtual const char* getName() const = 0;
+
+    void onTransportStats(const TransportStats& stats)
+    {
+        onStats(stats, detector.update(stats));
+    }
+
+    /// current 为编码器当前码率, nominal 为码流标称码率, 返回新的目标码率; 与 current 相同表示保持
+    virtual int64_t getTargetBitrate(int64_t current, int64_t nominal) = 0;
+
+    void reset()
+    {
+        detector.reset();
+        onReset();
+    }
+
+    const CongestionSignals& getSignals() const
+    {
+        return detector.getSignals();
+    }
+
+    void setSignalThresholds(const CongestionSignalDetector::Thresholds& thresholds)
+    {
+        detector.setThresholds(thresholds);
+    }
+
+    /// 目标码率限制在 [nominal * minRatio, nominal * maxRatio]
+    void setLimits(double minRatio, double maxRatio)
+    {
+        min_ratio = minRatio;
+        max_ratio = maxRatio;
+    }
+
+    double getMinRatio() const
+    {
+        return min_ratio;
+    }
+
+    double getMaxRatio() const
+    {
+        return max_ratio;
+    }
+
+protected:
+    BitrateController()
+        : XLogLevelBase()
+    {
+    }
+
+    virtual void onStats(const TransportStats& stats, const CongestionSignals& signals) = 0;
+
+    virtual void onReset() = 0;
+
+    int64_t clampBitrate(double bitrate, int64_t nominal) const
+    {
+        return static_cast<int64_t>(std::clamp(bitrate, nominal * min_ratio, nominal * max_ratio));
+    }
+
+protected:
+    double min_ratio = 0.4;
+    double max_ratio = 1.3;
+
+private:
+    CongestionSignalDetector detector;
+};
+
+/// SRTWrap 原有的算法: 用窗口内 min RTT 和 max 发送速率估算 BDP, 与 in-flight 比较决定升降
+class HeuristicBitrateController final : public BitrateController {
+public:
+    const char* getName() const override
+    {
+        return "heuristic";
+    }
+
+    int64_t getTargetBitrate(int64_t current, int64_t nominal) override
+    {
+        static constexpr double INCR_RATION = 1.08;
+        static constexpr double DECR_RATION = 0.85;
+
+        if (congestion_state == STATE_INCR) { // not adjust bitrate for bandwith is enough
+            if (current < nominal * max_ratio) {
+                dlog("increase");
+                return current * INCR_RATION;
+            }
+        } else if (congestion_state == STATE_DECR) { // adjust bitrate to estimate_bandwith cbr
+            if (current > nominal * min_ratio) {
+                dlog("decrease");
+                return current * DECR_RATION;
+            }
+        }
+
+        return current;
+    }
+
+protected:
+    void onStats(const TransportStats& stats, const CongestionSignals& signals) override
+    {
+        updateRTT(stats.nowMs, stats.rttMs);
+        updateMaxBW(stats.nowMs, stats.sendRateBps);
+        congestion_state = getState(stats.inflightBytes);
+        if (signals.level == CongestionSignals::Level::Severe) {
+            congestion_state = STATE_DECR;
+        } else if (signals.level == CongestionSignals::Level::Early && congestion_state == STATE_INCR) {
+            congestion_state = STATE_KEEP;
+        }
+    }
+
+    void onReset() override
+    {
+        rtt_filter.Reset();
+        bw_filter.Reset();
+        bw_avg.Reset();
+        state_window.clear();
+        state_sum = 0;
+        congestion_state = STATE_KEEP;
+    }
+
+private:
+    // 每个采样都更新窗口估计, 窗口长度与原来 6 个 300ms 采样的批量相当
+    void updateRTT(int64_t now, int rtt)
+    {
+        rtt_filter.Update(std::max(rtt, RTT_MIN), now);
+        rtt_min = rtt_filter.Best();
+    }
+
+    // update current max bandwith(bits/s)
+    void updateMaxBW(int64_t now, uint64_t bw)
+    {
+        bw_filter.Update(bw, now);
+        avg_bw = bw_avg.Update(static_cast<double>(bw));
+        bw_max = (bw_filter.Best() + avg_bw) * 1.2 / 2;
+    }
+
+    // get the state whether adjust the encoder bitrate.
+    int getState(int64_t inflight)
+    {
+        static constexpr int64_t INCR = SRT_LIVE_PAYLOAD_SIZE * 8 * 3;
+        static constexpr int64_t DECR = -SRT_LIVE_PAYLOAD_SIZE * 8 * 6;
+
+        const double bdp = bw_max * rtt_min / 1000;
+        inflight = inflight * 8;
+        const int64_t current_state = cwnd_gain * bdp - inflight;
+
+        // 最近 STATE_LIST_MAX 个采样的滑动和
+        state_window.push_back(current_state);
+        state_sum += current_state;
+        if (state_window.size() > STATE_LIST_MAX) {
+            state_sum -= state_window.front();
+            state_window.pop_front();
+        }
+        if (state_window.size() < STATE_LIST_MAX) {
+            return STATE_KEEP;
+        }
+
+        const int64_t final_state = state_sum;
+        dlog("get congestion inflight:{}, _bw_max:{}, _bw_avg:{}, _rtt_min:{}, bdp:{}, final_state:{}, current_state:{}",
+            inflight, bw_max, avg_bw, rtt_min, bdp, final_state, current_state);
+
+        if (final_state > (INCR)) {
+            return STATE_INCR;
+        } else if (final_state < (DECR - 1)) {
+            return STATE_DECR;
+        }
+
+        return STATE_KEEP;
+    }
+
+private:
+    static constexpr int64_t RTT_WINDOW_MS = 2000;
+    static constexpr int64_t BW_WINDOW_MS = 2000;
+    static constexpr double BW_AVG_ALPHA = 0.25;
+    static constexpr size_t STATE_LIST_MAX = 6;
+    static constexpr double CWND_GAIN_DEF = 1.3;
+    static constexpr int RTT_INIT = 100;
+    static constexpr int RTT_MIN = 35;
+
+    enum {
+        STATE_INCR = 0x01,
+        STATE_DECR = 0x02,
+        STATE_KEEP = 0x03,
+    };
+
+private:
+    xlab::WindowedMinFilter<int> rtt_filter { RTT_WINDOW_MS };
+    int rtt_min = RTT_INIT; // ms
+
+    xlab::WindowedMaxFilter<uint64_t> bw_filter { BW_WINDOW_MS }; // bits/s
+    xlab::Ewma bw_avg { BW_AVG_ALPHA };
+    uint64_t bw_max = 0; // bits/s, max srt bandwidth
+    uint64_t avg_bw = 0; // bits/s, avg srt bandwidth
+
+    xlab::RingBuffer<int64_t> state_window { STATE_LIST_MAX + 1 };
+    int64_t state_sum = 0;
+
+    double cwnd_gain = CWND_GAIN_DEF;
+    int congestion_state = STATE_KEEP;
+};
+
+/// 类 BBR: 窗口内最大发送速率作为瓶颈带宽, 窗口内最小 RTT 作为传播时延,
+/// 启动阶段逐步放大直到带宽不再增长, 之后按增益周期探测; in-flight 超过 2 倍 BDP 或出现严重拥塞信号时立即回落,
+/// 早期信号时暂停探测
+class BBRBitrateController final : public BitrateController {
+public:
+    const char* getName() const override
+    {
+        return "bbr";
+    }
+
+    int64_t getTargetBitrate(int64_t current, int64_t nominal) override
+    {
+        if (target <= 0) {
+            return current;
+        }
+        return clampBitrate(target, nominal);
+    }
+
+protected:
+    void onStats(const TransportStats& stats, const CongestionSignals& signals) override
+    {
+        rtt_filter.Update(std::max(stats.rttMs, RTT_MIN), stats.nowMs);
+        bw_filter.Update(stats.sendRateBps, ++round);
+        min_rtt = rtt_filter.Best();
+        btl_bw = bw_filter.Best();
+        const double bdp = btl_bw / 8.0 * min_rtt / 1000;
+
+        if (mode == Mode::Startup) {
+            // 连续 3 个采样带宽增长不足 25% 认为已到瓶颈
+            if (btl_bw >= full_bw * 1.25) {
+                full_bw = btl_bw;
+                full_bw_count = 0;
+            } else if (++full_bw_count >= 3) {
+                mode = Mode::Drain;
+                dlog("startup done, btl_bw:{}, min_rtt:{}", btl_bw, min_rtt);
+            }
+        }
+        if (mode == Mode::Drain && stats.inflightBytes <= bdp) {
+            mode = Mode::ProbeBW;
+            cycle_index = 0;
+            cycle_start_ms = stats.nowMs;
+        }
+        if (mode == Mode::ProbeBW && stats.nowMs - cycle_start_ms >= min_rtt) {
+            cycle_index = (cycle_index + 1) % PROBE_GAINS.size();
+            cycle_start_ms = stats.nowMs;
+        }
+
+        double gain = 1.0;
+        switch (mode) {
+        case Mode::Startup:
+            gain = STARTUP_GAIN;
+            break;
+        case Mode::Drain:
+            gain = DRAIN_GAIN;
+            break;
+        case Mode::ProbeBW:
+            gain = PROBE_GAINS[cycle_index];
+            break;
+        }
+        if (stats.inflightBytes > CWND_GAIN * bdp || signals.level == CongestionSignals::Level::Severe) {
+            gain = std::min(gain, QUEUE_GAIN);
+        } else if (signals.level == CongestionSignals::Level::Early) {
+            gain = std::min(gain, 1.0);
+        }
+        target = btl_bw * gain;
+        dlog("mode:{}, gain:{}, btl_bw:{}, min_rtt:{}, bdp:{}, inflight:{}", (int)mode, gain, btl_bw, min_rtt, bdp, stats.inflightBytes);
+    }
+
+    void onReset() override
+    {
+        rtt_filter.Reset();
+        bw_filter.Reset();
+        round = 0;
+        min_rtt = 0;
+        btl_bw = 0;
+        full_bw = 0;
+        full_bw_count = 0;
+        mode = Mode::Startup;
+        cycle_index = 0;
+        cycle_start_ms = 0;
+        target = 0;
+    }
+
+private:
+    enum class Mode {
+        Startup,
+        Drain,
+        ProbeBW,
+    };
+
+    static constexpr int RTT_MIN = 35;
+    static constexpr int64_t RTT_WINDOW_MS = 10 * 1000;
+    static constexpr int64_t BW_WINDOW = 10; // 采样个数
+    static constexpr double STARTUP_GAIN = 1.25;
+    static constexpr double DRAIN_GAIN = 0.75;
+    static constexpr double CWND_GAIN = 2.0;
+    static constexpr double QUEUE_GAIN = 0.85;
+    static constexpr std::array<double, 8> PROBE_GAINS { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+    xlab::WindowedMinFilter<int> rtt_filter { RTT_WINDOW_MS };
+    xlab::WindowedMaxFilter<int64_t> bw_filter { BW_WINDOW - 1 };
+    int64_t round = 0;
+    int min_rtt = 0;
+    int64_t btl_bw = 0;
+    int64_t full_bw = 0;
+    int full_bw_count = 0;
+    Mode mode = Mode::Startup;
+    size_t cycle_index = 0;
+    int64_t cycle_start_ms = 0;
+    double target = 0;
+};
+
+/// 类 GCC: RTT 趋势线斜率与自适应阈值比较检测过载, AIMD 调整时延目标;
+/// 丢包率超过 10% 按丢包比例回退, 低于 2% 缓慢上探; 取两者较小值. 严重拥塞信号按过载处理, 早期信号时暂停上调
+class GCCBitrateController final : public BitrateController {
+public:
+    const char* getName() const override
+    {
+        return "gcc";
+    }
+
+    int64_t getTargetBitrate(int64_t current, int64_t nominal) override
+    {
+        if (delay_target <= 0) {
+            delay_target = loss_target = current;
+            return current;
+        }
+        return clampBitrate(std::min(delay_target, loss_target), nominal);
+    }
+
+protected:
+    void onStats(const TransportStats& stats, const CongestionSignals& signals) override
+    {
+        const int64_t elapsed = last_ms > 0 ? std::max<int64_t>(stats.nowMs - last_ms, 1) : 0;
+        last_ms = stats.nowMs;
+        send_rate = stats.sendRateBps;
+
+        Usage usage = detect(stats.nowMs, stats.rttMs, elapsed);
+        if (delay_target <= 0) {
+            return;
+        }
+        // 发送缓冲积压或发送端丢包与时延过载同等处理, 早期信号时不再上调
+        if (signals.level == CongestionSignals::Level::Severe) {
+            usage = Usage::Overuse;
+        }
+        const bool hold = signals.level == CongestionSignals::Level::Early;
+
+        // 时延控制: 过载回退到实际发送速率的 85%, 之后保持一轮; 正常状态下回到增长
+        switch (usage) {
+        case Usage::Overuse:
+            // 持续过载时每个响应周期(RTT + 100ms)再退一次
+            if (rate_state != RateState::Decrease || stats.nowMs - last_decrease_ms >= stats.rttMs + 100) {
+                last_decrease_ms = stats.nowMs;
+                last_decrease = send_rate * BETA;
+                delay_target = std::min(delay_target, last_decrease);
+                rate_state = RateState::Decrease;
+            }
+            break;
+        case Usage::Underuse:
+            rate_state = RateState::Hold;
+            break;
+        case Usage::Normal:
+            if (rate_state == RateState::Hold) {
+                rate_state = RateState::Increase;
+            } else if (rate_state == RateState::Decrease) {
+                rate_state = RateState::Hold;
+            } else if (!hold) {
+                increase(elapsed, stats.rttMs);
+            }
+            break;
+        }
+
+        // 丢包控制
+        if (signals.lossRate > 0.1) {
+            loss_target = loss_target * (1 - 0.5 * signals.lossRate);
+        } else if (signals.lossRate < 0.02 && !hold) {
+            loss_target = loss_target * 1.05;
+        }
+
+        // 不超过实际发送速率的 1.5 倍, 避免编码器空闲时目标无限增长
+        if (send_rate > 0) {
+            delay_target = std::min(delay_target, send_rate * 1.5);
+            loss_target = std::min(loss_target, send_rate * 1.5);
+        }
+        dlog("usage:{}, trend:{}, threshold:{}, delay_target:{}, loss_target:{}", (int)usage, trend, threshold, delay_target, loss_target);
+    }
+
+    void onReset() override
+    {
+        samples.clear();
+        first_ms = 0;
+        last_ms = 0;
+        trend = 0;
+        threshold = THRESHOLD_INIT;
+        overuse_count = 0;
+        rate_state = RateState::Hold;
+        send_rate = 0;
+        last_decrease = 0;
+        last_decrease_ms = 0;
+        delay_target = 0;
+        loss_target = 0;
+    }
+
+private:
+    enum class Usage {
+        Normal,
+        Overuse,
+        Underuse,
+    };
+
+    enum class RateState {
+        Hold,
+        Increase,
+        Decrease,
+    };
+
+    /// 对最近 TREND_WINDOW 个 (时间, RTT) 做最小二乘, 斜率放大后与自适应阈值比较
+    Usage detect(int64_t now, int rtt, int64_t elapsed)
+    {
+        if (first_ms == 0) {
+            first_ms = now;
+        }
+        samples.emplace_back(static_cast<double>(now - first_ms), static_cast<double>(rtt));
+        while (samples.size() > TREND_WINDOW) {
+            samples.pop_front();
+        }
+        if (samples.size() < 2) {
+            return Usage::Normal;
+        }
+
+        double mean_x = 0, mean_y = 0;
+        for (const auto& [x, y] : samples) {
+            mean_x += x;
+            mean_y += y;
+        }
+        mean_x /= samples.size();
+        mean_y /= samples.size();
+        double num = 0, den = 0;
+        for (const auto& [x, y] : samples) {
+            num += (x - mean_x) * (y - mean_y);
+            den += (x - mean_x) * (x - mean_x);
+        }
+        const double slope = den > 0 ? num / den : 0;
+        trend = slope * samples.size() * TREND_GAIN;
+
+        // 阈值跟随趋势变化, 偏离过大的尖峰不参与调整
+        const double deviation = std::abs(trend);
+        if (deviation < threshold + 15) {
+            const double k = deviation > threshold ? K_UP : K_DOWN;
+            threshold = std::clamp(threshold + k * (deviation - threshold) * std::min<int64_t>(elapsed, 100), 6.0, 600.0);
+        }
+
+        if (trend > threshold) {
+            return ++overuse_count >= 2 ? Usage::Overuse : Usage::Normal;
+        }
+        overuse_count = 0;
+        return trend < -threshold ? Usage::Underuse : Usage::Normal;
+    }
+
+    void increase(int64_t elapsed, int rtt)
+    {
+        if (last_decrease > 0 && delay_target >= last_decrease * 0.95) {
+            // 接近上次过载点, 每个响应周期加一个包
+            const double response_ms = std::max(rtt, 35) + 100.0;
+            delay_target += SRT_LIVE_PAYLOAD_SIZE * 8 * 1000 / response_ms * elapsed / response_ms;
+        } else {
+            delay_target *= std::pow(1.08, std::min<int64_t>(elapsed, 1000) / 1000.0);
+        }
+    }
+
+private:
+    static constexpr size_t TREND_WINDOW = 20;
+    static constexpr double TREND_GAIN = 20.0; // 采样间隔远大于 GCC 的包组间隔, 放大增益补偿
+    static constexpr double THRESHOLD_INIT = 12.5;
+    static constexpr double K_UP = 0.01;
+    static constexpr double K_DOWN = 0.00018;
+    static constexpr double BETA = 0.85;
+
+    std::deque<std::pair<double, double>> samples;
+    int64_t first_ms = 0;
+    int64_t last_ms = 0;
+    double trend = 0;
+    double threshold = THRESHOLD_INIT;
+    int overuse_count = 0;
+    RateState rate_state = RateState::Hold;
+    double send_rate = 0;
+    double last_decrease = 0;
+    int64_t last_decrease_ms = 0;
+    double delay_target = 0;
+    double loss_target = 0;
+};
+
+inline std::unique_ptr<BitrateController> BitrateController::Make(Algorithm algorithm)
+{
+    switch (algorithm) {
+    case Algorithm::BBR:
+        return std::make_unique<BBRBitrateController>();
+    case Algorithm::GCC:
+        return std::make_unique<GCCBitrateController>();
+    case Algorithm::Heuristic:
+    default:
+        return std::make_unique<HeuristicBitrateController>();
+    }
+}
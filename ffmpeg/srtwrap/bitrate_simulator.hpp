@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <istream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitrate_controller.hpp"
+
+/// 离线的码率控制仿真: 用假时钟驱动一条瓶颈链路, 按 SRTWrap 的节奏(统计 300ms, 编码器 500ms)喂给 BitrateController,
+/// 不依赖网络和 libsrt, 同样的场景和种子每次结果相同, 用于调参和算法回归对比
+class BitrateSimulator final {
+public:
+    /// 一段链路条件, 持续 durationMs 后切到下一段
+    struct Phase {
+        int64_t durationMs = 10 * 1000;
+        int64_t capacityBps = 8 * 1000 * 1000;
+        int baseRttMs = 40;
+        double lossRate = 0; // 随机丢包率, 与排队溢出丢包叠加
+    };
+
+    struct Scenario {
+        std::string name;
+        int64_t nominalBps = 4 * 1000 * 1000;
+        int64_t initialBps = 4 * 1000 * 1000;
+        int64_t queueLimitMs = 500; // 瓶颈缓冲区能容纳的时长, 超出即丢包
+        int64_t latencyMs = 1000; // SRT 延迟, 发送缓冲积压超过该时长的待重传数据被发送端丢弃
+        int64_t sndBufBytes = 8 << 20; // 发送缓冲容量
+        uint32_t seed = 1;
+        std::vector<Phase> phases;
+    };
+
+    struct Options {
+        int64_t stepMs = 10;
+        int64_t statsIntervalMs = 300;
+        int64_t encoderIntervalMs = 500;
+        double settleBand = 0.75; // 码率落在 [settleBand, 1.1] * 可用上限视为收敛
+        int64_t settleMs = 2000; // 需要连续保持的时长
+    };
+
+    struct Sample {
+        int64_t nowMs = 0;
+        int64_t capacityBps = 0;
+        int64_t bitrateBps = 0;
+        int rttMs = 0;
+    };
+
+    struct Report {
+        std::string controller;
+        std::string scenario;
+        std::vector<Sample> timeline; // 每个统计周期一条
+        std::vector<int64_t> phaseConvergenceMs; // 每段的收敛时间, -1 表示未收敛
+        int64_t convergenceMs = 0; // 各段中最差的收敛时间
+        double utilization = 0; // 实际送达 / 可用上限 的时间平均
+        double overshoot = 0; // 码率超出链路容量的最大比例
+        double overshootTimeRatio = 0; // 码率高于链路容量的时间占比
+        int64_t maxRttMs = 0;
+        int64_t lostPackets = 0;
+        int64_t droppedPackets = 0; // 发送端因超过延迟丢弃
+        int64_t maxSndBufMs = 0;
+    };
+
+    /// 闭环仿真: 控制器的输出决定下一时刻的发送速率
+    static Report Run(BitrateController& controller, const Scenario& scenario)
+    {
+        return Run(controller, scenario, Options());
+    }
+
+    static Report Run(BitrateController& controller, const Scenario& scenario, const Options& options)
+    {
+        Report report;
+        report.controller = controller.getName();
+        report.scenario = scenario.name;
+        controller.reset();
+
+        std::mt19937 generator(scenario.seed);
+        int64_t now = 0;
+        int64_t bitrate = scenario.initialBps;
+        double queue_bytes = 0;
+        double pending_retrans = 0;
+
+        // 一个统计周期内的累计
+        double sent_bytes = 0, delivered_bytes = 0, lost_bytes = 0, retrans_bytes = 0, dropped_bytes = 0;
+        int64_t last_stats = 0, last_encoder = 0;
+
+        double utilization_sum = 0;
+        int64_t above_ms = 0, total_ms = 0;
+
+        for (const auto& phase : scenario.phases) {
+            const int64_t phase_start = now;
+            const double ceiling = usableBitrate(scenario, controller, phase);
+            int64_t settled_since = -1;
+            int64_t converged = -1;
+
+            for (int64_t elapsed = 0; elapsed < phase.durationMs; elapsed += options.stepMs) {
+                now += options.stepMs;
+                const double step_s = options.stepMs / 1000.0;
+                const double capacity_bytes = phase.capacityBps / 8.0 * step_s;
+
+                // 发送端: 编码输出加上待重传
+                const double retrans = std::min(pending_retrans, capacity_bytes);
+                pending_retrans -= retrans;
+                const double input = bitrate / 8.0 * step_s + retrans;
+                sent_bytes += input;
+                retrans_bytes += retrans;
+
+                // 随机丢包在入队前发生
+                double random_lost = 0;
+                if (phase.lossRate > 0) {
+                    const double draw = static_cast<double>(generator()) / std::mt19937::max();
+                    random_lost = input * phase.lossRate * 2 * draw;
+                }
+                queue_bytes += input - random_lost;
+
+                // 瓶颈: 按容量出队, 超出缓冲区的部分丢弃
+                const double delivered = std::min(queue_bytes, capacity_bytes);
+                queue_bytes -= delivered;
+                const double queue_limit = phase.capacityBps / 8.0 * scenario.queueLimitMs / 1000;
+                const double overflow = std::max(queue_bytes - queue_limit, 0.0);
+                queue_bytes -= overflow;
+
+                delivered_bytes += delivered;
+                lost_bytes += random_lost + overflow;
+                pending_retrans += random_lost + overflow;
+
+                utilization_sum += std::min(delivered / step_s * 8 / ceiling, 1.0) * options.stepMs;
+                if (bitrate > phase.capacityBps) {
+                    above_ms += options.stepMs;
+                }
+                report.overshoot = std::max(report.overshoot, static_cast<double>(bitrate) / phase.capacityBps - 1);
+                total_ms += options.stepMs;
+
+                const int rtt = phase.baseRttMs + static_cast<int>(queue_bytes * 8 * 1000 / phase.capacityBps);
+                report.maxRttMs = std::max<int64_t>(report.maxRttMs, rtt);
+
+                // 发送缓冲: 未确认的数据(链路上 + 瓶颈排队) 加上待重传, 积压超过延迟的部分被丢弃
+                const double unacked = std::min(bitrate, phase.capacityBps) / 8.0 * phase.baseRttMs / 1000 + queue_bytes;
+                const double byte_rate = std::max(bitrate, int64_t(1)) / 8.0;
+                const double expired = std::min(std::max(unacked + pending_retrans - byte_rate * scenario.latencyMs / 1000, 0.0), pending_retrans);
+                pending_retrans -= expired;
+                dropped_bytes += expired;
+                const double snd_buf = std::min(unacked + pending_retrans, static_cast<double>(scenario.sndBufBytes));
+                const int snd_buf_ms = static_cast<int>(snd_buf / byte_rate * 1000);
+                report.maxSndBufMs = std::max<int64_t>(report.maxSndBufMs, snd_buf_ms);
+
+                if (now - last_stats >= options.statsIntervalMs) {
+                    const double interval_s = (now - last_stats) / 1000.0;
+                    TransportStats stats;
+                    stats.nowMs = now;
+                    stats.rttMs = rtt;
+                    stats.sendRateBps = static_cast<int64_t>(delivered_bytes * 8 / interval_s);
+                    stats.inflightBytes = static_cast<int64_t>(delivered_bytes / interval_s * phase.baseRttMs / 1000 + queue_bytes);
+                    stats.pktSent = static_cast<int64_t>(sent_bytes / SRT_LIVE_PAYLOAD_SIZE);
+                    stats.pktLoss = static_cast<int64_t>(lost_bytes / SRT_LIVE_PAYLOAD_SIZE);
+                    stats.pktRetrans = static_cast<int64_t>(retrans_bytes / SRT_LIVE_PAYLOAD_SIZE);
+                    stats.pktSndDrop = static_cast<int64_t>(dropped_bytes / SRT_LIVE_PAYLOAD_SIZE);
+                    stats.sndBufMs = snd_buf_ms;
+                    stats.sndBufBytes = static_cast<int64_t>(snd_buf);
+                    stats.availSndBufBytes = scenario.sndBufBytes - stats.sndBufBytes;
+                    controller.onTransportStats(stats);
+
+                    report.lostPackets += stats.pktLoss;
+                    report.droppedPackets += stats.pktSndDrop;
+                    report.timeline.push_back({ now, phase.capacityBps, bitrate, rtt });
+                    sent_bytes = delivered_bytes = lost_bytes = retrans_bytes = dropped_bytes = 0;
+                    last_stats = now;
+                }
+
+                if (now - last_encoder >= options.encoderIntervalMs) {
+                    bitrate = controller.getTargetBitrate(bitrate, scenario.nominalBps);
+                    last_encoder = now;
+                }
+
+                if (converged < 0) {
+                    if (bitrate >= ceiling * options.settleBand && bitrate <= ceiling * 1.1) {
+                        if (settled_since < 0) {
+                            settled_since = now;
+                        }
+                        if (now - settled_since >= options.settleMs) {
+                            converged = settled_since - phase_start;
+                        }
+                    } else {
+                        settled_since = -1;
+                    }
+                }
+            }
+
+            report.phaseConvergenceMs.push_back(converged);
+        }
+
+        for (const auto converged : report.phaseConvergenceMs) {
+            report.convergenceMs = converged < 0 || report.convergenceMs < 0 ? -1 : std::max(report.convergenceMs, converged);
+        }
+        if (total_ms > 0) {
+            report.utilization = utilization_sum / total_ms;
+            report.overshootTimeRatio = static_cast<double>(above_ms) / total_ms;
+        }
+        return report;
+    }
+
+    /// 开环回放: 按记录的统计序列驱动控制器, 链路不响应码率变化, 只得到码率时间线
+    static Report Replay(BitrateController& controller, const std::vector<TransportStats>& trace, int64_t nominalBps, int64_t encoderIntervalMs = 500)
+    {
+        Report report;
+        report.controller = controller.getName();
+        report.scenario = "replay";
+        controller.reset();
+
+        int64_t bitrate = nominalBps;
+        int64_t last_encoder = trace.empty() ? 0 : trace.front().nowMs;
+        for (const auto& stats : trace) {
+            controller.onTransportStats(stats);
+            if (stats.nowMs - last_encoder >= encoderIntervalMs) {
+                bitrate = controller.getTargetBitrate(bitrate, nominalBps);
+                last_encoder = stats.nowMs;
+            }
+            report.lostPackets += stats.pktLoss;
+            report.droppedPackets += stats.pktSndDrop;
+            report.maxSndBufMs = std::max<int64_t>(report.maxSndBufMs, stats.sndBufMs);
+            report.maxRttMs = std::max<int64_t>(report.maxRttMs, stats.rttMs);
+            report.timeline.push_back({ stats.nowMs, stats.sendRateBps, bitrate, stats.rttMs });
+        }
+        return report;
+    }
+
+    /// 解析 srt-live-transmit -statsout 的 CSV(首行为表头), 只取 Time/msTimeStamp, msRTT, mbpsSendRate,
+    /// pktFlightSize, pktSent, pktSndLoss, pktRetrans, pktSndDrop, msSndBuf, byteSndBuf, byteAvailSndBuf 列; 缺少的列按 0 处理,
+    /// 数值无法解析的行(截断的日志, 混入的文本)整行跳过
+    static std::vector<TransportStats> ParseTrace(std::istream& input)
+    {
+        std::vector<TransportStats> trace;
+        std::string line;
+        if (!std::getline(input, line)) {
+            return trace;
+        }
+
+        std::map<std::string, size_t> columns;
+        const auto header = splitCSV(line);
+        for (size_t i = 0; i < header.size(); i++) {
+            columns[header[i]] = i;
+        }
+        const auto column = [&columns](const std::vector<std::string>& fields, std::initializer_list<const char*> names) {
+            for (const auto name : names) {
+                auto iter = columns.find(name);
+                if (iter != columns.end() && iter->second < fields.size() && !fields[iter->second].empty()) {
+                    return std::stod(fields[iter->second]);
+                }
+            }
+            return 0.0;
+        };
+
+        while (std::getline(input, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            const auto fields = splitCSV(line);
+            TransportStats stats;
+            try {
+                stats.nowMs = static_cast<int64_t>(column(fields, { "msTimeStamp", "Time" }));
+                stats.rttMs = static_cast<int>(column(fields, { "msRTT" }));
+                stats.sendRateBps = static_cast<int64_t>(column(fields, { "mbpsSendRate" }) * 1000 * 1000);
+                stats.inflightBytes = static_cast<int64_t>(column(fields, { "pktFlightSize" })) * SRT_LIVE_PAYLOAD_SIZE;
+                stats.pktSent = static_cast<int64_t>(column(fields, { "pktSent" }));
+                stats.pktLoss = static_cast<int64_t>(column(fields, { "pktSndLoss" }));
+                stats.pktRetrans = static_cast<int64_t>(column(fields, { "pktRetrans" }));
+                stats.pktSndDrop = static_cast<int64_t>(column(fields, { "pktSndDrop" }));
+                stats.sndBufMs = static_cast<int>(column(fields, { "msSndBuf" }));
+                stats.sndBufBytes = static_cast<int64_t>(column(fields, { "byteSndBuf" }));
+                stats.availSndBufBytes = static_cast<int64_t>(column(fields, { "byteAvailSndBuf" }));
+            } catch (const std::invalid_argument&) {
+                continue;
+            } catch (const std::out_of_range&) {
+                continue;
+            }
+            trace.push_back(stats);
+        }
+        return trace;
+    }
+
+    /// 内置的合成场景: 带宽骤降, RTT 突增, 突发丢包
+    static std::vector<Scenario> BuiltinScenarios()
+    {
+        std::vector<Scenario> scenarios;
+
+        Scenario drop;
+        drop.name = "bandwidth_drop";
+        drop.phases = { { 20 * 1000, 8000000, 40, 0 }, { 20 * 1000, 2500000, 40, 0 }, { 20 * 1000, 8000000, 40, 0 } };
+        scenarios.push_back(drop);
+
+        Scenario spike;
+        spike.name = "rtt_spike";
+        spike.phases = { { 15 * 1000, 6000000, 40, 0 }, { 10 * 1000, 6000000, 300, 0 }, { 15 * 1000, 6000000, 40, 0 } };
+        scenarios.push_back(spike);
+
+        Scenario burst;
+        burst.name = "loss_burst";
+        burst.phases = { { 15 * 1000, 6000000, 60, 0 }, { 10 * 1000, 6000000, 60, 0.15 }, { 15 * 1000, 6000000, 60, 0.005 } };
+        scenarios.push_back(burst);
+
+        return scenarios;
+    }
+
+    /// 一行摘要, 便于贴到回归记录里对比
+    static std::string Summary(const Report& report)
+    {
+        std::ostringstream out;
+        out << report.controller << "/" << report.scenario
+            << " convergence_ms=" << report.convergenceMs
+            << " utilization=" << report.utilization
+            << " overshoot=" << report.overshoot
+            << " overshoot_time=" << report.overshootTimeRatio
+            << " max_rtt_ms=" << report.maxRttMs
+            << " lost=" << report.lostPackets
+            << " dropped=" << report.droppedPackets
+            << " max_snd_buf_ms=" << report.maxSndBufMs;
+        return out.str();
+    }
+
+private:
+    /// 这一段里码率能达到的上限: 链路容量与控制器上限 nominal * maxRatio 的较小者
+    static double usableBitrate(const Scenario& scenario, const BitrateController& controller, const Phase& phase)
+    {
+        return std::min<double>(phase.capacityBps, scenario.nominalBps * controller.getMaxRatio());
+    }
+
+    static std::vector<std::string> splitCSV(const std::string& line)
+    {
+        std::vector<std::string> fields;
+        std::string field;
+        std::istringstream stream(line);
+        while (std::getline(stream, field, ',')) {
+            field.erase(0, field.find_first_not_of(" \t\r"));
+            field.erase(field.find_last_not_of(" \t\r") + 1);
+            fields.push_back(field);
+        }
+        return fields;
+    }
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <srt/srt.h>
+
+#include "bitrate_controller.hpp"
+#include "common/seqlock.hpp"
+#include "container/snapshot_map.hpp"
+#include "thread/thread_wrap.hpp"
+#include "time/time_utils.hpp"
+#include "xlog_common.hpp"
+
+/// 多个 SRT 连接共用的统计轮询服务: 一个线程按固定节拍批量 srt_bstats 所有注册的 socket,
+/// 结果通过顺序锁发布到每个 socket 的槽位, 读者(SRTWrap)不加锁取最新一份, 读者跟不上节拍时计数也不会丢;
+/// 注册表用 SnapshotMap 保存, 轮询线程通过 Reader 读取, 注册表不变时不加锁
+class SRTStatsPoller : public XLogLevelBase {
+public:
+    /// 一个 socket 的发布槽位, 由轮询线程单写. 发布的计数类字段是注册以来的累计值,
+    /// 读者隔几个版本才读一次时, 中间版本的丢包/重传等计数仍会计入下一次读到的增量
+    struct Slot {
+        explicit Slot(SRTSOCKET sock)
+            : sock(sock)
+        {
+        }
+
+        /// 读出最新一份并返回版本号, 计数类字段换算为距 consumed 的增量;
+        /// consumed 是该读者上次读到的累计值, 每个读者各持一份, 初值用 stats.Load 取得
+        uint64_t Load(TransportStats& delta, TransportStats& consumed) const
+        {
+            TransportStats current;
+            const uint64_t version = stats.Load(current);
+            delta = current;
+            delta.pktSent = current.pktSent - consumed.pktSent;
+            delta.pktLoss = current.pktLoss - consumed.pktLoss;
+            delta.pktRetrans = current.pktRetrans - consumed.pktRetrans;
+            delta.pktSndDrop = current.pktSndDrop - consumed.pktSndDrop;
+            consumed = current;
+            return version;
+        }
+
+        const SRTSOCKET sock;
+        xlab::SeqLock<TransportStats> stats;
+        std::atomic<uint64_t> failures = 0;
+
+    private:
+        friend class SRTStatsPoller;
+
+        /// 把一次 srt_bstats 的增量加到累计值上再发布, 只由轮询线程调用
+        void publish(TransportStats sample)
+        {
+            totals.pktSent += sample.pktSent;
+            totals.pktLoss += sample.pktLoss;
+            totals.pktRetrans += sample.pktRetrans;
+            totals.pktSndDrop += sample.pktSndDrop;
+            sample.pktSent = totals.pktSent;
+            sample.pktLoss = totals.pktLoss;
+            sample.pktRetrans = totals.pktRetrans;
+            sample.pktSndDrop = totals.pktSndDrop;
+            stats.Store(sample);
+        }
+
+        TransportStats totals;
+    };
+
+    struct Statistic {
+        uint64_t rounds = 0;
+        uint64_t polls = 0;
+        uint64_t failures = 0;
+        int64_t maxRoundUs = 0;
+        int64_t maxLateUs = 0; // 实际开始时间相对节拍的最大延后
+    };
+
+    static std::shared_ptr<SRTStatsPoller> Make(const xlab::Time::Interval& interval = xlab::Time::Interval(std::chrono::milliseconds(300)))
+    {
+        auto poller = std::shared_ptr<SRTStatsPoller>(new SRTStatsPoller(interval));
+        poller->worker = std::make_unique<ThreadWrap>("srt_stats_poller", [thiz = poller.get()]() { thiz->loop(); });
+        return poller;
+    }
+
+    /// 取一个 socket 的统计并换算为 TransportStats, 计数类字段为距上次清零的增量
+    static bool ToTransportStats(SRTSOCKET sock, int64_t nowMs, TransportStats& stats)
+    {
+        SRT_TRACEBSTATS perf;
+        if (srt_bstats(sock, &perf, 1) != 0) {
+            return false;
+        }
+
+        stats.nowMs = nowMs;
+        stats.rttMs = static_cast<int>(perf.msRTT);
+        stats.sendRateBps = perf.mbpsSendRate * 1000 * 1000;
+        stats.inflightBytes = perf.pktFlightSize * SRT_LIVE_PAYLOAD_SIZE;
+        stats.pktSent = perf.pktSent;
+        stats.pktLoss = perf.pktSndLoss;
+        stats.pktRetrans = perf.pktRetrans;
+        stats.pktSndDrop = perf.pktSndDrop;
+        stats.sndBufMs = perf.msSndBuf;
+        stats.sndBufBytes = perf.byteSndBuf;
+        stats.availSndBufBytes = perf.byteAvailSndBuf;
+        // srt_bstats 的缓冲统计是周期内的快照, 优先用实时占用
+        size_t snd_buf_bytes = 0, snd_buf_blocks = 0;
+        if (srt_getsndbuffer(sock, &snd_buf_blocks, &snd_buf_bytes) != SRT_ERROR) {
+            stats.sndBufBytes = snd_buf_bytes;
+        }
+        return true;
+    }
+
+private:
+    explicit SRTStatsPoller(const xlab::Time::Interval& interval)
+        : XLogLevelBase()
+        , interval(interval)
+    {
+    }
+
+public:
+    ~SRTStatsPoller()
+    {
+        requestExit();
+        worker.reset();
+    }
+
+    /// 重复注册返回已有槽位
+    std::shared_ptr<Slot> registerSocket(SRTSOCKET sock)
+    {
+        std::shared_ptr<Slot> slot;
+        slots.Update([&slot, sock](auto& map) {
+            auto& value = map[sock];
+            if (value == nullptr) {
+                value = std::make_shared<Slot>(sock);
+            }
+            slot = value;
+        });
+        return slot;
+    }
+
+    void unregisterSocket(SRTSOCKET sock)
+    {
+        slots.Erase(sock);
+    }
+
+    size_t getSocketCount() const
+    {
+        return slots.Size();
+    }
+
+    xlab::Time::Interval getInterval() const
+    {
+        return interval;
+    }
+
+    Statistic getStatistic() const
+    {
+        Statistic statistic;
+        statistic.rounds = rounds.load(std::memory_order_relaxed);
+        statistic.polls = polls.load(std::memory_order_relaxed);
+        statistic.failures = failures.load(std::memory_order_relaxed);
+        statistic.maxRoundUs = maxRoundUs.load(std::memory_order_relaxed);
+        statistic.maxLateUs = maxLateUs.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+    bool isExit() const
+    {
+        return exiting.load(std::memory_order_acquire);
+    }
+
+    void requestExit()
+    {
+        {
+            std::lock_guard<std::mutex> locker(exitMutex);
+            exiting = true;
+        }
+        exitCond.notify_all();
+    }
+
+private:
+    void loop()
+    {
+        // 按绝对节拍唤醒, 单轮耗时不会累积成漂移
+        auto deadline = std::chrono::steady_clock::now();
+        const auto step = interval.ToChrono<std::chrono::nanoseconds>();
+        while (true) {
+            deadline += step;
+            {
+                std::unique_lock<std::mutex> locker(exitMutex);
+                exitCond.wait_until(locker, deadline, [this]() { return isExit(); });
+                if (isExit()) {
+                    return;
+                }
+            }
+
+            const auto begin = xlab::Time::Point::Now();
+            const int64_t late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - deadline).count();
+            updateMax(maxLateUs, late);
+            poll(begin.RawValue<std::chrono::milliseconds>());
+            updateMax(maxRoundUs, (xlab::Time::Point::Now() - begin).RawValue<std::chrono::microseconds>());
+
+            // 落后超过一个节拍时跳过错过的节拍, 不补轮询
+            const auto now = std::chrono::steady_clock::now();
+            if (now - deadline > step) {
+                deadline = now;
+            }
+        }
+    }
+
+    void poll(int64_t nowMs)
+    {
+        // 同一轮的所有 socket 使用同一个时间戳
+        const auto& snapshot = slotsReader.Get();
+        for (const auto& [sock, slot] : snapshot) {
+            TransportStats stats;
+            if (!ToTransportStats(sock, nowMs, stats)) {
+                slot->failures.fetch_add(1, std::memory_order_relaxed);
+                failures.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            slot->publish(stats);
+        }
+        polls.fetch_add(snapshot.size(), std::memory_order_relaxed);
+        rounds.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void updateMax(std::atomic<int64_t>& value, int64_t sample)
+    {
+        int64_t current = value.load(std::memory_order_relaxed);
+        while (sample > current && !value.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    const xlab::Time::Interval interval;
+    xlab::SnapshotMap<SRTSOCKET, std::shared_ptr<Slot>> slots;
+    xlab::SnapshotMap<SRTSOCKET, std::shared_ptr<Slot>>::Reader slotsReader { slots }; // 只在轮询线程使用
+    std::unique_ptr<ThreadWrap> worker;
+    std::mutex exitMutex;
+    std::condition_variable exitCond;
+    std::atomic<bool> exiting = false;
+    std::atomic<uint64_t> rounds = 0;
+    std::atomic<uint64_t> polls = 0;
+    std::atomic<uint64_t> failures = 0;
+    std::atomic<int64_t> maxRoundUs = 0;
+    std::atomic<int64_t> maxLateUs = 0;
+};
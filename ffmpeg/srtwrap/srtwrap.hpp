@@ -1,12 +1,12 @@
 #pragma once
 
-#include <algorithm>
-#include <array>
-#include <atomic>
-#include <numeric>
+#include <memory>
+#include <mutex>
 
 #include <srt/srt.h>
 
+#include "bitrate_controller.hpp"
+#include "srt_stats_poller.hpp"
 #include "task/task.hpp"
 #include "time/time_utils.hpp"
 #include "xlog_common.hpp"
@@ -15,34 +15,40 @@ using namespace xlab;
 
 class SRTWrap : public XLogLevelBase {
 public:
-    explicit SRTWrap(SRTSOCKET sock)
+    explicit SRTWrap(SRTSOCKET sock, BitrateController::Algorithm algorithm = BitrateController::Algorithm::Heuristic)
         : sock(sock)
         , XLogLevelBase()
+        , bitrate_controller(BitrateController::Make(algorithm))
     {
     }
 
     ~SRTWrap()
     {
+        detachStatsPoller();
     }
 
-    bool updateVideoEncodeBitate(int64_t& current_vencode_bitrate, const int64_t video_stream_bitrate)
+    /// 更换码率控制算法, 新控制器从头开始估计
+    void setBitrateController(std::unique_ptr<BitrateController> controller)
+    {
+        if (controller == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> locker(controller_mutex);
+        bitrate_controller = std::move(controller);
+    }
+
+    const char* getBitrateControllerName()
     {
-        static constexpr double INCR_RATION = 1.08;
-        static constexpr double DECR_RATION = 0.85;
+        std::lock_guard<std::mutex> locker(controller_mutex);
+        return bitrate_controller->getName();
+    }
 
+    bool updateVideoEncodeBitate(int64_t& current_vencode_bitrate, const int64_t video_stream_bitrate)
+    {
         int64_t tmp_vencode_bitrate = current_vencode_bitrate;
         if (update_vencode_bitrate_task.run([this, &current_vencode_bitrate, &video_stream_bitrate, &tmp_vencode_bitrate] {
-                if (congestion_state == STATE_INCR) { // not adjust bitrate for bandwith is enough
-                    if (current_vencode_bitrate < video_stream_bitrate * 1.3) {
-                        tmp_vencode_bitrate = current_vencode_bitrate * INCR_RATION;
-                        dlog("increase");
-                    }
-                } else if (congestion_state == STATE_DECR) { // adjust bitrate to estimate_bandwith cbr
-                    if (current_vencode_bitrate > video_stream_bitrate * 0.4) {
-                        tmp_vencode_bitrate = current_vencode_bitrate * DECR_RATION;
-                        dlog("decrease");
-                    }
-                }
+                std::lock_guard<std::mutex> locker(controller_mutex);
+                tmp_vencode_bitrate = bitrate_controller->getTargetBitrate(current_vencode_bitrate, video_stream_bitrate);
             })) {
             update_vencode_bitrate_task.reset();
             if (tmp_vencode_bitrate != current_vencode_bitrate) {
@@ -56,30 +62,61 @@ public:
         return false;
     }
 
+    /// 改由共享的 SRTStatsPoller 采集统计, congestionCtrl 只消费轮询线程发布的最新一份; 需与 congestionCtrl 在同一线程调用
+    void attachStatsPoller(const std::shared_ptr<SRTStatsPoller>& poller)
+    {
+        detachStatsPoller();
+        if (poller != nullptr) {
+            stats_slot = poller->registerSocket(sock);
+            last_stats_version = stats_slot->stats.Load(consumed_stats);
+            stats_poller = poller;
+        }
+    }
+
+    void detachStatsPoller()
+    {
+        if (auto poller = stats_poller.lock()) {
+            poller->unregisterSocket(sock);
+        }
+        stats_poller.reset();
+        stats_slot.reset();
+    }
+
     void congestionCtrl()
     {
+        // 轮询服务已销毁时退回自己轮询
+        if (stats_slot != nullptr && stats_poller.expired()) {
+            stats_slot.reset();
+        }
+        if (stats_slot != nullptr) {
+            // 没有新数据时只读一次版本号
+            if (stats_slot->stats.Version() == last_stats_version) {
+                return;
+            }
+            TransportStats stats;
+            last_stats_version = stats_slot->Load(stats, consumed_stats);
+            onTransportStats(stats);
+            return;
+        }
+
         if (srt_congestion_ctrl_task.run([this] {
-                SRT_TRACEBSTATS perf;
-                const auto srt_bstats_result = srt_bstats(sock, &perf, 1);
-                if (srt_bstats_result != 0) {
+                TransportStats stats;
+                if (!SRTStatsPoller::ToTransportStats(sock, xlab::Time::Point::Now().RawValue<std::chrono::milliseconds>(), stats)) {
                     return;
                 }
-
-                const int64_t inflight = perf.pktFlightSize * 188 * 7;
-                const int64_t bw_bitrate = perf.mbpsSendRate * 1000 * 1000; //_last_send_bytes*8*1000/diff_t;
-                const int rtt = std::max((int)(perf.msRTT), RTT_MIN);
-
-                updateRTT(rtt);
-                updateMaxBW(bw_bitrate);
-                congestion_state = srtBitrateGetState(inflight);
-
-                dlog("congestion ctrl({}) return {}, rtt:{}, inflight:{}, bw_bitrate:{}",
-                    sock, srt_bstats_result, rtt, inflight, bw_bitrate);
+                onTransportStats(stats);
             })) {
             srt_congestion_ctrl_task.reset();
         }
     }
 
+    /// 最近一次统计得到的拥塞信号, 供监控面板展示
+    CongestionSignals getCongestionSignals()
+    {
+        std::lock_guard<std::mutex> locker(controller_mutex);
+        return bitrate_controller->getSignals();
+    }
+
     SRT_SOCKSTATUS getSockstate() const
     {
         return srt_getsockstate(sock);
@@ -101,93 +138,33 @@ public:
     }
 
 private:
-    void updateRTT(int rtt)
+    void onTransportStats(const TransportStats& stats)
     {
-        rtt_array.push_back(rtt = std::max(rtt, RTT_MIN));
-        if ((rtt_ready = rtt_array.size() >= RTT_LIST_MAX)) {
-            rtt_min = *std::min_element(rtt_array.begin(), rtt_array.end());
-            rtt_array.clear();
-            dlog("update rtt={}, input rtt:{}", rtt_min, rtt);
+        {
+            std::lock_guard<std::mutex> locker(controller_mutex);
+            bitrate_controller->onTransportStats(stats);
         }
-    }
 
-    // update current max bandwith(bits/s)
-    void updateMaxBW(uint64_t maxbw)
-    {
-        bw_array.push_back(maxbw);
-        if ((bw_ready = bw_array.size() >= BW_LIST_MAX)) {
-            avg_bw = std::accumulate(bw_array.begin(), bw_array.end(), 0) / bw_array.size();
-            bw_max = *std::max_element(bw_array.begin(), bw_array.end());
-            bw_max = (bw_max + avg_bw) * 1.2 / 2;
-            bw_array.clear();
-        }
-    }
-
-    // get the state whether adjust the encoder bitrate.
-    int srtBitrateGetState(int inflight)
-    {
-        static constexpr int64_t INCR = 1316 * 8 * 3;
-        static constexpr int64_t DECR = -1316 * 8 * 6;
-
-        if (!rtt_ready || !bw_ready) {
-            return STATE_KEEP;
-        }
-
-        const double bdp = bw_max * rtt_min / 1000;
-        inflight = inflight * 8;
-        const int64_t current_state = cwnd_gain * bdp - inflight;
-        state_array.push_back(current_state);
-        if (!(state_ready = state_array.size() >= STATE_LIST_MAX)) {
-            return STATE_KEEP;
-        }
-
-        const int64_t final_state = std::accumulate(state_array.begin(), state_array.end(), 0l);
-        dlog("get congestion inflight:{}, _bw_max:{}, _bw_avg:{}, _rtt_min:{}, bdp:{}, final_state:{}, current_state:{}",
-            inflight, bw_max, avg_bw, rtt_min, bdp, final_state, current_state);
-
-        if (final_state > (INCR)) {
-            return STATE_INCR;
-        } else if (final_state < (DECR - 1)) {
-            return STATE_DECR;
-        }
-
-        return STATE_KEEP;
+        dlog("congestion ctrl({}), rtt:{}, inflight:{}, bw_bitrate:{}, loss:{}, retrans:{}, snd_drop:{}, snd_buf_ms:{}, snd_buf_bytes:{}",
+            sock, stats.rttMs, stats.inflightBytes, stats.sendRateBps,
+            stats.pktLoss, stats.pktRetrans, stats.pktSndDrop, stats.sndBufMs, stats.sndBufBytes);
     }
 
 private:
     static constexpr auto VIDEO_UPDATE_INTERVAL = 500ms;
 
     static constexpr auto SRT_CHECK_INTERVAL = 300ms;
-    static constexpr int RTT_LIST_MAX = 6;
-    static constexpr int BW_LIST_MAX = 6;
-    static constexpr int STATE_LIST_MAX = 6;
-    static constexpr double CWND_GAIN_DEF = 1.3;
-    static constexpr int RTT_INIT = 100;
-    static constexpr int RTT_MIN = 35;
-
-    enum {
-        STATE_INCR = 0x01,
-        STATE_DECR = 0x02,
-        STATE_KEEP = 0x03,
-    };
 
 private:
     SRTSOCKET sock;
 
-    std::vector<int> rtt_array;
-    int rtt_min = RTT_INIT; // ms
-    bool rtt_ready = false;
-
-    std::vector<uint64_t> bw_array; // bits/s
-    uint64_t bw_max = 0; // bits/s, max srt bandwidth
-    uint64_t avg_bw = 0; // bits/s, avg srt bandwidth
-    bool bw_ready = false;
-
-    std::vector<int64_t> state_array;
-    bool state_ready = false;
+    std::mutex controller_mutex;
+    std::unique_ptr<BitrateController> bitrate_controller;
 
-    double cwnd_gain = CWND_GAIN_DEF;
-    std::atomic<int> congestion_state = STATE_KEEP;
+    std::weak_ptr<SRTStatsPoller> stats_poller;
+    std::shared_ptr<SRTStatsPoller::Slot> stats_slot;
+    uint64_t last_stats_version = 0;
+    TransportStats consumed_stats; // 上次从槽位读到的计数累计值
 
     xlab::Task update_vencode_bitrate_task { 1, VIDEO_UPDATE_INTERVAL };
     xlab::Task srt_congestion_ctrl_task { 1, SRT_CHECK_INTERVAL };
@@ -0,0 +1,106 @@
+/// 码率控制回归: 每个内置场景对每种控制器各跑两遍, 检查结果可复现并落在约定范围内, 任一项不满足返回非零;
+/// 带一个 srt-live-transmit -statsout 的 CSV 路径参数时, 额外对每种控制器开环回放并打印摘要
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bitrate_simulator.hpp"
+
+namespace {
+
+struct Bounds {
+    double minUtilization = 0.6;
+    double maxOvershoot = 1.5;
+    int64_t maxConvergenceMs = 15 * 1000;
+    double stallLossRate = 0.1; // 随机丢包率高于此值的段允许不收敛, 控制器在这种链路上退到低码率是正确行为
+};
+
+const BitrateController::Algorithm ALGORITHMS[] = {
+    BitrateController::Algorithm::Heuristic,
+    BitrateController::Algorithm::BBR,
+    BitrateController::Algorithm::GCC,
+};
+
+int failures = 0;
+
+void expect(bool condition, const BitrateSimulator::Report& report, const std::string& what)
+{
+    if (!condition) {
+        failures += 1;
+        printf("FAIL %s/%s: %s\n", report.controller.c_str(), report.scenario.c_str(), what.c_str());
+    }
+}
+
+void checkScenario(const BitrateSimulator::Scenario& scenario, const Bounds& bounds)
+{
+    for (const auto algorithm : ALGORITHMS) {
+        auto controller = BitrateController::Make(algorithm);
+        const auto report = BitrateSimulator::Run(*controller, scenario);
+        const auto again = BitrateSimulator::Run(*controller, scenario);
+        printf("%s\n", BitrateSimulator::Summary(report).c_str());
+
+        expect(BitrateSimulator::Summary(report) == BitrateSimulator::Summary(again), report, "not deterministic");
+        expect(report.utilization >= bounds.minUtilization, report, "utilization " + std::to_string(report.utilization));
+        expect(report.overshoot <= bounds.maxOvershoot, report, "overshoot " + std::to_string(report.overshoot));
+        expect(report.maxSndBufMs <= scenario.latencyMs, report, "send buffer " + std::to_string(report.maxSndBufMs) + "ms");
+        expect(report.phaseConvergenceMs.size() == scenario.phases.size(), report, "phase count");
+        for (size_t i = 0; i < report.phaseConvergenceMs.size() && i < scenario.phases.size(); i++) {
+            const int64_t convergence = report.phaseConvergenceMs[i];
+            if (convergence < 0 && scenario.phases[i].lossRate > bounds.stallLossRate) {
+                continue;
+            }
+            expect(convergence >= 0 && convergence <= bounds.maxConvergenceMs, report,
+                "phase " + std::to_string(i) + " convergence " + std::to_string(convergence) + "ms");
+        }
+    }
+}
+
+void checkParseTrace()
+{
+    // 第 3 行不是数字, 第 4 行超出 double 范围, 都应整行跳过
+    std::istringstream input("Time,SocketID,msRTT,mbpsSendRate,pktFlightSize,pktSent,pktSndLoss\n"
+                             "0,1,40,4.0,30,120,0\n"
+                             "300,1,n/a,4.1,31,121,1\n"
+                             "600,1,45,1e999,31,121,1\n"
+                             "900,1,300,2.0,200,60,10\n");
+    const auto trace = BitrateSimulator::ParseTrace(input);
+    if (trace.size() != 2 || trace[1].nowMs != 900 || trace[1].rttMs != 300) {
+        failures += 1;
+        printf("FAIL ParseTrace: %zu rows\n", trace.size());
+    }
+}
+
+void replay(const std::string& path)
+{
+    std::ifstream input(path);
+    if (!input) {
+        failures += 1;
+        printf("FAIL open %s\n", path.c_str());
+        return;
+    }
+    const auto trace = BitrateSimulator::ParseTrace(input);
+    for (const auto algorithm : ALGORITHMS) {
+        auto controller = BitrateController::Make(algorithm);
+        const auto report = BitrateSimulator::Replay(*controller, trace, 4 * 1000 * 1000);
+        printf("%s\n", BitrateSimulator::Summary(report).c_str());
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    for (const auto& scenario : BitrateSimulator::BuiltinScenarios()) {
+        checkScenario(scenario, Bounds());
+    }
+    checkParseTrace();
+    if (argc > 1) {
+        replay(argv[1]);
+    }
+
+    printf("%s\n", failures == 0 ? "PASS" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
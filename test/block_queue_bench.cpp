@@ -0,0 +1,62 @@
+/// BlockQueue 存储对比: 默认的 RingBuffer 与原来的 std::list, 一个生产者一个消费者,
+/// 报告吞吐和入队到出队的延迟分位; 参数为 [元素个数] [队列容量]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "container/block_queue.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+template <typename Queue>
+void bench(const char* name, int count, int capacity)
+{
+    Queue queue(capacity);
+    std::vector<int64_t> latency;
+    latency.reserve(count);
+
+    const auto begin = Clock::now();
+    std::thread producer([&queue, count]() {
+        for (int i = 0; i < count; i++) {
+            queue.Push(nowNs());
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        const auto stamp = queue.Pop();
+        latency.push_back(nowNs() - stamp.value_or(0));
+    }
+    producer.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::sort(latency.begin(), latency.end());
+    printf("%-6s %8.2f Mops/s  p50 %8lldns  p99 %8lldns  max %10lldns\n", name, count / seconds / 1e6,
+        (long long)latency[latency.size() / 2], (long long)latency[latency.size() * 99 / 100], (long long)latency.back());
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const int count = argc > 1 ? std::max(1, atoi(argv[1])) : 500000;
+    const int capacity = argc > 2 ? std::max(1, atoi(argv[2])) : 64;
+    printf("count %d capacity %d\n", count, capacity);
+
+    // 交替跑两轮, 减少 CPU 频率和缓存预热带来的偏差
+    for (int round = 0; round < 2; round++) {
+        bench<xlab::BlockQueue<int64_t>>("ring", count, capacity);
+        bench<xlab::BlockQueue<int64_t, std::list<int64_t>>>("list", count, capacity);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/// 本地文件输入方式对比: 默认的 avformat_open_input, FFReadAheadInput 和 mmapInput,
+/// 报告墙钟时间和自定义 AVIO 统计的系统调用次数; 参数为 <输入文件> [输出文件]
+/// 输入最好是几 GB 的大文件; 每种方式开始前用 POSIX_FADV_DONTNEED 丢掉输入的页缓存
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ffremuxer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void dropPageCache(const std::string& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+int64_t fileSize(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+void printIO(const char* name, const FFIOBase::Statistic& statistic)
+{
+    printf("  %-6s syscalls %8llu  bytes %12llu  seeks %6llu\n", name,
+        (unsigned long long)statistic.syscalls, (unsigned long long)statistic.bytes, (unsigned long long)statistic.seeks);
+}
+
+bool bench(const char* name, const std::string& in, const std::string& out, const FFIOOptions* ioOptions)
+{
+    dropPageCache(in);
+
+    const auto begin = Clock::now();
+    auto muxer = FFRemuxer::Make(in, out, ioOptions);
+    if (muxer == nullptr) {
+        return false;
+    }
+    const int result = muxer->run();
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    const auto input = muxer->getInputIOStatistic();
+    printf("%-10s wall %8.3fs  %8.1fMB/s  result %d\n", name, seconds, fileSize(in) / seconds / (1 << 20), result);
+    if (ioOptions == nullptr) {
+        // 默认路径走 FFmpeg 自己的 file 协议, 没有统计
+        printf("  input  syscalls        -\n");
+    } else {
+        printIO("input", input);
+        printIO("output", muxer->getOutputIOStatistic());
+    }
+    return result == 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("usage: %s <input> [output]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string in = argv[1];
+    const std::string out = argc > 2 ? argv[2] : "/dev/shm/ffavio_bench.ts";
+
+    FFIOOptions readAhead;
+    FFIOOptions mmap;
+    mmap.mmapInput = true;
+
+    bool ok = true;
+    ok = bench("default", in, out, nullptr) && ok;
+    ok = bench("readahead", in, out, &readAhead) && ok;
+    ok = bench("mmap", in, out, &mmap) && ok;
+    if (argc <= 2) {
+        remove(out.c_str());
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/// FFRemuxer 读写方式对比: 流水线的 run() 与单线程串行 read/write 循环,
+/// 报告墙钟时间和两个阶段的 I/O 耗时; 参数为 <输入文件> [输出文件]
+/// 输出默认写到 tmpfs 上的临时文件, 近似 /dev/null, 只保留输入端和复用本身的开销
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "ffremuxer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsedUs(const Clock::time_point& since)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+void addStage(FFRemuxer::StageStatistic& stage, int size, int64_t costUs)
+{
+    stage.packets++;
+    stage.bytes += size;
+    stage.totalUs += costUs;
+    stage.maxUs = std::max(stage.maxUs, costUs);
+}
+
+void printStage(const char* name, const FFRemuxer::StageStatistic& stage)
+{
+    printf("  %-5s packets %8llu  bytes %12llu  total %10lldus  max %8lldus\n", name,
+        (unsigned long long)stage.packets, (unsigned long long)stage.bytes, (long long)stage.totalUs, (long long)stage.maxUs);
+}
+
+bool benchRun(const std::string& in, const std::string& out)
+{
+    auto muxer = FFRemuxer::Make(in, out);
+    if (muxer == nullptr) {
+        return false;
+    }
+
+    const auto begin = Clock::now();
+    const int result = muxer->run();
+    const int64_t wallUs = elapsedUs(begin);
+
+    const auto statistic = muxer->getRunStatistic();
+    printf("run    wall %10lldus  result %d  peakDepth %zu  maxQueue %lldus\n", (long long)wallUs, result,
+        statistic.peakDepth, (long long)statistic.maxQueueUs);
+    printStage("read", statistic.read);
+    printStage("write", statistic.write);
+    return result == 0;
+}
+
+/// 与 run() 之前的用法一致: 读一个包, 立即写一个包
+bool benchSerial(const std::string& in, const std::string& out)
+{
+    auto muxer = FFRemuxer::Make(in, out);
+    if (muxer == nullptr) {
+        return false;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    FFRemuxer::StageStatistic read;
+    FFRemuxer::StageStatistic write;
+    bool ok = true;
+
+    const auto begin = Clock::now();
+    while (true) {
+        auto since = Clock::now();
+        if (!muxer->read(packet)) {
+            // read 对被丢弃的流也返回 false, 这时 code 不为负
+            if (muxer->getCode() < 0) {
+                ok = muxer->getCode() == AVERROR_EOF;
+                break;
+            }
+            continue;
+        }
+        addStage(read, packet->size, elapsedUs(since));
+
+        const int size = packet->size;
+        since = Clock::now();
+        if (!muxer->write(packet)) {
+            ok = false;
+            break;
+        }
+        addStage(write, size, elapsedUs(since));
+    }
+    const int64_t wallUs = elapsedUs(begin);
+    av_packet_free(&packet);
+
+    printf("serial wall %10lldus  result %d\n", (long long)wallUs, ok ? 0 : muxer->getCode());
+    printStage("read", read);
+    printStage("write", write);
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("usage: %s <input> [output]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string in = argv[1];
+    const std::string out = argc > 2 ? argv[2] : "/dev/shm/ffremuxer_bench.ts";
+
+    // 交替跑两轮, 第一轮顺便把输入读进页缓存
+    bool ok = true;
+    for (int round = 0; round < 2; round++) {
+        ok = benchRun(in, out) && ok;
+        ok = benchSerial(in, out) && ok;
+    }
+    if (argc <= 2) {
+        remove(out.c_str());
+    }
+    return ok ? 0 : 1;
+}
@@ -8,3 +8,7 @@
 
 #define IMPORT_CONSTRUCTOR_DEFAULT(CLASS_NAME) \
     explicit CLASS_NAME() = default;
+
+#ifndef XLAB_CACHE_LINE_SIZE
+#define XLAB_CACHE_LINE_SIZE 64
+#endif
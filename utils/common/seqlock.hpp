@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "common/macro_conf.hpp"
+
+namespace xlab {
+
+/// 单写者多读者的顺序锁: 写者从不阻塞, 读者在读到写了一半的数据时重试.
+/// 数据按 64 位字逐个原子读写, 避免读写并发时的数据竞争; 只适合小的可平凡拷贝的结构
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock()
+    {
+        Store(T());
+    }
+
+    SeqLock(const SeqLock&) = delete;
+
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /// 只能由一个线程调用
+    void Store(const T& value)
+    {
+        std::array<uint64_t, WORDS> words {};
+        memcpy(words.data(), &value, sizeof(T));
+
+        const uint64_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /// 返回一致的快照
+    T Load() const
+    {
+        T value;
+        Load(value);
+        return value;
+    }
+
+    /// 读出一致的快照, 返回对应的版本号(每次 Store 加一, 初始为 0)
+    uint64_t Load(T& value) const
+    {
+        std::array<uint64_t, WORDS> words;
+        uint64_t begin = 0;
+        while (true) {
+            begin = _seq.load(std::memory_order_acquire);
+            if (begin & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == begin) {
+                break;
+            }
+        }
+        memcpy(&value, words.data(), sizeof(T));
+        return begin / 2 - 1;
+    }
+
+    /// 版本号, 与 Load 返回值一致, 可用来判断是否有新数据而不拷贝
+    uint64_t Version() const
+    {
+        return _seq.load(std::memory_order_acquire) / 2 - 1;
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(XLAB_CACHE_LINE_SIZE) std::atomic<uint64_t> _seq { 0 };
+    std::array<std::atomic<uint64_t>, WORDS> _words {};
+};
+
+}
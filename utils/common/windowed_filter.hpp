@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "container/ring_buffer.hpp"
+
+namespace xlab {
+
+/// 滑动窗口极值, 单调队列实现: 每个样本入队出队各一次, Update 均摊 O(1), Best O(1).
+/// 窗口单位由调用方决定, 传时间戳就是时间窗口, 传样本序号就是计数窗口;
+/// Compare(a, b) 为 true 表示 a 比 b 更优, std::less 得到最小值, std::greater 得到最大值
+template <typename T, typename Compare, typename Stamp = int64_t>
+class WindowedFilter {
+public:
+    explicit WindowedFilter(Stamp window)
+        : _window(window)
+    {
+    }
+
+    /// now 需单调不减; 早于 now - window 的样本被淘汰
+    void Update(const T& value, Stamp now)
+    {
+        // 队尾不比新样本优的样本永远不会再成为极值
+        while (!_samples.empty() && !_compare(_samples.back().value, value)) {
+            _samples.pop_back();
+        }
+        _samples.push_back({ value, now });
+        Expire(now);
+    }
+
+    /// 只淘汰过期样本, 用于长时间没有新样本时
+    void Expire(Stamp now)
+    {
+        // 至少保留最新的样本
+        while (_samples.size() > 1 && now - _samples.front().stamp > _window) {
+            _samples.pop_front();
+        }
+    }
+
+    /// 窗口内的极值, 调用前需确认 !Empty()
+    const T& Best() const
+    {
+        return _samples.front().value;
+    }
+
+    bool Empty() const
+    {
+        return _samples.empty();
+    }
+
+    void SetWindow(Stamp window)
+    {
+        _window = window;
+    }
+
+    Stamp Window() const
+    {
+        return _window;
+    }
+
+    void Reset()
+    {
+        _samples.clear();
+    }
+
+private:
+    struct Sample {
+        T value;
+        Stamp stamp;
+    };
+
+    RingBuffer<Sample> _samples;
+    Stamp _window;
+    Compare _compare;
+};
+
+template <typename T, typename Stamp = int64_t>
+using WindowedMinFilter = WindowedFilter<T, std::less<T>, Stamp>;
+
+template <typename T, typename Stamp = int64_t>
+using WindowedMaxFilter = WindowedFilter<T, std::greater<T>, Stamp>;
+
+/// 指数加权移动平均, 第一个样本直接作为初值
+class Ewma {
+public:
+    explicit Ewma(double alpha)
+        : _alpha(alpha)
+    {
+    }
+
+    double Update(double value)
+    {
+        _value = _ready ? _value + _alpha * (value - _value) : value;
+        _ready = true;
+        return _value;
+    }
+
+    double Value() const
+    {
+        return _value;
+    }
+
+    bool Ready() const
+    {
+        return _ready;
+    }
+
+    void Reset()
+    {
+        _value = 0;
+        _ready = false;
+    }
+
+private:
+    double _alpha;
+    double _value = 0;
+    bool _ready = false;
+};
+
+}
@@ -1,22 +1,48 @@
 #pragma once
 
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
 #include <functional>
 #include <list>
 #include <optional>
-#include <queue>
 #include <shared_mutex>
 
+#include "container/ring_buffer.hpp"
 #include "semaphore/semaphore.hpp"
 
 namespace xlab {
 
-template <typename E>
+/// 队列满时 Push 的处理方式
+enum class QueueDropPolicy {
+    Block, // 阻塞等待空位
+    DropOldest, // 丢弃队头最旧的元素, 新元素入队
+    DropNewest, // 丢弃新元素
+    DropUntilKey, // 丢弃新元素及其后所有非关键元素, 直到下一个关键元素到来; 关键元素到来时队列仍满则清空积压
+};
+
+/// Container 为底层存储, 默认使用预留 max 容量的 RingBuffer, 稳态下入队出队无堆分配;
+/// 需要旧的链表行为时可指定 std::list<E>
+template <typename E, typename Container = RingBuffer<E>>
 class BlockQueue {
 
 public:
     using value_type = E;
+    using container_type = Container;
     using reference = value_type&;
     using const_reference = const value_type&;
+    using KeyPredicate = std::function<bool(const E&)>;
+
+    struct DropStatistic {
+        uint64_t oldest = 0;
+        uint64_t newest = 0;
+        uint64_t untilKey = 0;
+
+        uint64_t Total() const
+        {
+            return oldest + newest + untilKey;
+        }
+    };
 
 private:
     BlockQueue(const BlockQueue&) = delete;
@@ -28,32 +54,94 @@ private:
     BlockQueue& operator=(BlockQueue&&) = delete;
 
 public:
-    BlockQueue(int max = 3)
-        : mMaxCount(max)
-        , mSemapIn(max)
+    /// max 为负数时按 0 处理
+    BlockQueue(int max = 3, QueueDropPolicy policy = QueueDropPolicy::Block, KeyPredicate is_key = nullptr)
+        : mMaxCount(std::max(max, 0))
+        , mSemapIn(mMaxCount)
         , mSemapOut(0)
+        , mPolicy(policy)
+        , mIsKey(std::move(is_key))
     {
+        assert(max > 0);
+        Reserve(mQueue, mMaxCount, 0);
     }
 
     ~BlockQueue() = default;
 
     bool TryPush(const E& element)
+    {
+        return TryEmplace(element);
+    }
+
+    bool TryPush(E&& element)
+    {
+        return TryEmplace(std::move(element));
+    }
+
+    template <typename... Args>
+    bool TryEmplace(Args&&... args)
     {
         if (mSemapIn.TryWait()) {
             std::lock_guard<decltype(mMutex)> locker(mMutex);
-            mQueue.push(element);
-            mSemapOut.Post();
+            mQueue.emplace_back(std::forward<Args>(args)...);
+            PostOutWithoutLock();
             return true;
         }
         return false;
     }
 
-    void Push(const E& element)
+    /// 返回元素是否入队, 只有非 Block 策略下才可能返回 false
+    bool Push(const E& element)
+    {
+        return Emplace(element);
+    }
+
+    bool Push(E&& element)
+    {
+        return Emplace(std::move(element));
+    }
+
+    template <typename... Args>
+    bool Emplace(Args&&... args)
+    {
+        if (mPolicy.load(std::memory_order_acquire) == QueueDropPolicy::Block) {
+            mSemapIn.Wait();
+            std::lock_guard<decltype(mMutex)> locker(mMutex);
+            mQueue.emplace_back(std::forward<Args>(args)...);
+            PostOutWithoutLock();
+            return true;
+        }
+        return PushOrDrop(E(std::forward<Args>(args)...));
+    }
+
+    /// is_key 为空时所有元素都视为关键元素
+    void SetDropPolicy(QueueDropPolicy policy, KeyPredicate is_key = nullptr)
     {
-        mSemapIn.Wait();
         std::lock_guard<decltype(mMutex)> locker(mMutex);
-        mQueue.push(element);
-        mSemapOut.Post();
+        mPolicy.store(policy, std::memory_order_release);
+        mIsKey = std::move(is_key);
+        mWaitKey = false;
+    }
+
+    QueueDropPolicy GetDropPolicy() const
+    {
+        return mPolicy.load(std::memory_order_acquire);
+    }
+
+    DropStatistic GetDropStatistic() const
+    {
+        DropStatistic statistic;
+        statistic.oldest = mDropOldest.load(std::memory_order_relaxed);
+        statistic.newest = mDropNewest.load(std::memory_order_relaxed);
+        statistic.untilKey = mDropUntilKey.load(std::memory_order_relaxed);
+        return statistic;
+    }
+
+    void ResetDropStatistic()
+    {
+        mDropOldest = 0;
+        mDropNewest = 0;
+        mDropUntilKey = 0;
     }
 
     void Pulse()
@@ -67,7 +155,8 @@ public:
         std::lock_guard<decltype(mMutex)> locker(mMutex);
         mSemapIn.ClearPost();
         mSemapOut.ClearPost();
-        mQueue = decltype(mQueue)();
+        mQueue.clear();
+        mWaitKey = false;
         mSemapIn.Post(mMaxCount);
     }
 
@@ -78,14 +167,20 @@ public:
 
     std::optional<E> TryPop(const std::chrono::nanoseconds& wait_time = std::chrono::nanoseconds::zero())
     {
-        if (mSemapOut.TryWait(wait_time)) {
-            std::optional<E> front = std::nullopt;
+        const auto deadline = Deadline(wait_time);
+        auto remain = wait_time;
+        while (mSemapOut.TryWait(std::max(remain, std::chrono::nanoseconds::zero()))) {
             std::lock_guard<decltype(mMutex)> lock(mMutex);
             if (mQueue.empty()) {
-                return front;
+                // 取到的是已被丢弃元素的出队信号, 继续等待剩余时间
+                if (ConsumeOwedWithoutLock()) {
+                    remain = Remain(deadline);
+                    continue;
+                }
+                return std::nullopt;
             }
-            front = std::make_optional(mQueue.front());
-            mQueue.pop();
+            auto front = std::make_optional(std::move(mQueue.front()));
+            mQueue.pop_front();
             mSemapIn.Post();
             return front;
         }
@@ -103,29 +198,27 @@ public:
     void ClearIf(std::function<bool(E&)> func)
     {
         std::lock_guard<decltype(mMutex)> lock(mMutex);
-        decltype(mQueue) newQueue;
-        while (!mQueue.empty()) {
-            auto element = mQueue.front();
-            mQueue.pop();
-            if (!func(element)) {
-                newQueue.push(element);
-            }
-        }
-        mQueue = newQueue;
+        mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(), func), mQueue.end());
     }
 
     std::optional<E> Pop()
     {
-        mSemapOut.Wait();
-        std::lock_guard<decltype(mMutex)> lock(mMutex);
-        if (mQueue.empty()) {
+        while (true) {
+            mSemapOut.Wait();
+            std::lock_guard<decltype(mMutex)> lock(mMutex);
+            if (mQueue.empty()) {
+                // 已被丢弃元素的出队信号, 对应的入队信号在丢弃时已归还, 重新等待
+                if (ConsumeOwedWithoutLock()) {
+                    continue;
+                }
+                mSemapIn.Post();
+                return std::nullopt;
+            }
+            auto front = std::make_optional(std::move(mQueue.front()));
+            mQueue.pop_front();
             mSemapIn.Post();
-            return std::nullopt;
+            return front;
         }
-        auto front = std::make_optional(mQueue.front());
-        mQueue.pop();
-        mSemapIn.Post();
-        return front;
     }
 
     std::optional<E> Front()
@@ -164,12 +257,144 @@ public:
         return mQueue.size() >= mMaxCount;
     }
 
+private:
+    bool IsKey(const E& element) const
+    {
+        return mIsKey == nullptr || mIsKey(element);
+    }
+
+    bool PushOrDrop(E&& element)
+    {
+        std::lock_guard<decltype(mMutex)> locker(mMutex);
+        const QueueDropPolicy policy = mPolicy.load(std::memory_order_relaxed);
+        if (policy == QueueDropPolicy::DropUntilKey && mWaitKey) {
+            if (!IsKey(element)) {
+                mDropUntilKey.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            mWaitKey = false;
+        }
+
+        if (mSemapIn.TryWait()) {
+            mQueue.emplace_back(std::move(element));
+            PostOutWithoutLock();
+            return true;
+        }
+
+        switch (policy) {
+        case QueueDropPolicy::DropOldest:
+            // 队列为空说明入队信号被切换策略前阻塞的生产者占着, 没有可替换的元素, 按 DropNewest 处理
+            if (mQueue.empty()) {
+                mDropNewest.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // 元素个数不变, 信号量无需调整
+            mQueue.pop_front();
+            mDropOldest.fetch_add(1, std::memory_order_relaxed);
+            mQueue.emplace_back(std::move(element));
+            return true;
+
+        case QueueDropPolicy::DropUntilKey:
+            if (!IsKey(element)) {
+                mWaitKey = true;
+                mDropUntilKey.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            DropAllWithoutLock();
+            if (!mSemapIn.TryWait()) {
+                // 切换策略期间入队信号可能被阻塞模式的生产者取走, 此时只能丢弃该关键元素并等待下一个
+                mWaitKey = true;
+                mDropUntilKey.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            mQueue.emplace_back(std::move(element));
+            PostOutWithoutLock();
+            return true;
+
+        case QueueDropPolicy::DropNewest:
+        default:
+            mDropNewest.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    /// 丢弃全部积压并归还它们的入队信号; 收不回的出队信号已被消费者取走(正阻塞在 mMutex 上),
+    /// 记入 mOwedOut, 由之后的入队顶替或由醒来的消费者消耗, 保持信号量与元素个数一致
+    void DropAllWithoutLock()
+    {
+        const size_t count = mQueue.size();
+        mQueue.clear();
+        mDropUntilKey.fetch_add(count, std::memory_order_relaxed);
+
+        size_t reclaimed = 0;
+        while (reclaimed < count && mSemapOut.TryWait()) {
+            ++reclaimed;
+        }
+        mOwedOut += count - reclaimed;
+        mSemapIn.Post(static_cast<int>(count));
+    }
+
+    /// 新元素入队后调用: 有消费者持有未对应元素的出队信号时由它取走该元素, 否则发出新的出队信号
+    void PostOutWithoutLock()
+    {
+        if (mOwedOut > 0) {
+            --mOwedOut;
+            return;
+        }
+        mSemapOut.Post();
+    }
+
+    bool ConsumeOwedWithoutLock()
+    {
+        if (mOwedOut == 0) {
+            return false;
+        }
+        --mOwedOut;
+        return true;
+    }
+
+    /// Futex::Infinite() 加上当前时间会溢出, 单独表示为永不到期
+    static std::chrono::steady_clock::time_point Deadline(std::chrono::nanoseconds wait_time)
+    {
+        if (wait_time == Futex::Infinite()) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return std::chrono::steady_clock::now() + wait_time;
+    }
+
+    static std::chrono::nanoseconds Remain(const std::chrono::steady_clock::time_point& deadline)
+    {
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            return Futex::Infinite();
+        }
+        return deadline - std::chrono::steady_clock::now();
+    }
+
+    template <typename C>
+    static auto Reserve(C& container, int max, int) -> decltype(container.reserve(max), void())
+    {
+        container.reserve(max);
+    }
+
+    template <typename C>
+    static void Reserve(C&, int, long)
+    {
+    }
+
 private:
     int mMaxCount;
     Semaphore mSemapIn;
     Semaphore mSemapOut;
     std::shared_mutex mMutex;
-    std::queue<E, std::list<E>> mQueue;
+    Container mQueue;
+
+    std::atomic<QueueDropPolicy> mPolicy;
+    KeyPredicate mIsKey;
+    bool mWaitKey = false;
+    size_t mOwedOut = 0; // 已被消费者取走但对应元素已丢弃的出队信号数
+    std::atomic<uint64_t> mDropOldest = 0;
+    std::atomic<uint64_t> mDropNewest = 0;
+    std::atomic<uint64_t> mDropUntilKey = 0;
 };
 
 }
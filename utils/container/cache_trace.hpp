@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "container/lru_cache.hpp"
+#include "container/policy_cache.hpp"
+#include "container/slab_lru_cache.hpp"
+
+namespace xlab::CacheTrace {
+
+struct Result {
+    std::string policy;
+    size_t capacity = 0;
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t evictions = 0;
+
+    double HitRatio() const
+    {
+        return requests == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(requests);
+    }
+};
+
+/// 读取录制的 key 序列, 每行一个 key, 忽略空行
+static inline std::vector<std::string> Load(const std::string& path)
+{
+    std::vector<std::string> trace;
+    std::ifstream input(path);
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty()) {
+            trace.emplace_back(std::move(line));
+        }
+    }
+    return trace;
+}
+
+/// 按序回放: 未命中时插入, 统计命中率; Cache 需要提供 TryGet/Put/GetStatistic
+template <typename Cache, typename K>
+static inline Result Replay(const std::string& policy, Cache& cache, const std::vector<K>& trace)
+{
+    cache.ResetStatistic();
+    for (const auto& key : trace) {
+        bool value = true;
+        if (!cache.TryGet(key, value)) {
+            cache.Put(key, value);
+        }
+    }
+
+    const auto statistic = cache.GetStatistic();
+    Result result;
+    result.policy = policy;
+    result.capacity = cache.Capacity();
+    result.requests = statistic.hits + statistic.misses;
+    result.hits = statistic.hits;
+    result.evictions = statistic.evictions;
+    return result;
+}
+
+/// 用同一份 trace 回放所有内置策略, 便于对比命中率
+template <typename K>
+static inline std::vector<Result> ReplayAll(const std::vector<K>& trace, size_t capacity)
+{
+    std::vector<Result> results;
+
+    LRUCache<K, bool> lru(capacity);
+    results.emplace_back(Replay("LRU", lru, trace));
+
+    SlabLRUCache<K, bool> slab(capacity);
+    results.emplace_back(Replay("SlabLRU", slab, trace));
+
+    PolicyCache<K, bool, LRUPolicy> policyLru(capacity);
+    results.emplace_back(Replay("PolicyLRU", policyLru, trace));
+
+    S3FIFOCache<K, bool> s3fifo(capacity);
+    results.emplace_back(Replay("S3-FIFO", s3fifo, trace));
+
+    return results;
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/macro_conf.hpp"
+
+namespace xlab {
+
+/// 按 key 的哈希分段加锁的并发 map, 读操作只持有所在分段的共享锁, 不同分段的写互不阻塞;
+/// 查询接口不会插入默认值, 复合操作(Compute/Upsert)在分段锁内原子完成
+template <typename K, typename V, size_t Stripes = 16, typename Hash = std::hash<K>>
+class ConcurrentMap {
+    static_assert(Stripes > 0 && (Stripes & (Stripes - 1)) == 0, "ConcurrentMap `Stripes` must be a power of two");
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const key_type, mapped_type>;
+
+private:
+    struct alignas(XLAB_CACHE_LINE_SIZE) Stripe {
+        std::unordered_map<K, V, Hash> umap;
+        mutable std::shared_mutex mutex;
+    };
+
+    std::array<Stripe, Stripes> _stripes;
+    Hash _hash;
+
+public:
+    ConcurrentMap() = default;
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+public:
+    void Set(const K& key, const V& value)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        stripe.umap[key] = value;
+    }
+
+    void Set(const K& key, V&& value)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        stripe.umap[key] = std::move(value);
+    }
+
+    /// key 不存在时插入, 返回是否插入
+    bool SetIfAbsent(const K& key, const V& value)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        return stripe.umap.emplace(key, value).second;
+    }
+
+    bool Find(const K& key) const
+    {
+        const auto& stripe = StripeOf(key);
+        std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+        return stripe.umap.find(key) != stripe.umap.end();
+    }
+
+    bool TryGet(const K& key, V& value) const
+    {
+        const auto& stripe = StripeOf(key);
+        std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+        auto iter = stripe.umap.find(key);
+        if (iter == stripe.umap.end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    /// 不存在时返回值初始化的 V, 适合 V 为 shared_ptr/指针的注册表
+    V GetOrNull(const K& key) const
+    {
+        const auto& stripe = StripeOf(key);
+        std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+        auto iter = stripe.umap.find(key);
+        return iter == stripe.umap.end() ? V {} : iter->second;
+    }
+
+    bool Erase(const K& key)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        return stripe.umap.erase(key) > 0;
+    }
+
+    /// 在分段锁内对 key 执行 func(V& value, bool exists), value 在 key 不存在时为默认值;
+    /// func 返回 false 时删除该 key(不存在时不插入). 返回调用后 key 是否存在
+    template <typename Func>
+    bool Compute(const K& key, Func&& func)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        auto iter = stripe.umap.find(key);
+        if (iter != stripe.umap.end()) {
+            if (!func(iter->second, true)) {
+                stripe.umap.erase(iter);
+                return false;
+            }
+            return true;
+        }
+
+        V value {};
+        if (!func(value, false)) {
+            return false;
+        }
+        stripe.umap.emplace(key, std::move(value));
+        return true;
+    }
+
+    /// key 不存在时插入 value, 存在时调用 merge(V& old, const V& value) 原地合并; 返回是否插入
+    template <typename Merge>
+    bool Upsert(const K& key, const V& value, Merge&& merge)
+    {
+        auto& stripe = StripeOf(key);
+        std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+        auto iter = stripe.umap.find(key);
+        if (iter != stripe.umap.end()) {
+            merge(iter->second, value);
+            return false;
+        }
+        stripe.umap.emplace(key, value);
+        return true;
+    }
+
+    void Clear()
+    {
+        for (auto& stripe : _stripes) {
+            std::lock_guard<std::shared_mutex> locker(stripe.mutex);
+            stripe.umap.clear();
+        }
+    }
+
+    /// 逐段统计, 并发写入时只是近似值
+    size_t Size() const
+    {
+        size_t size = 0;
+        for (const auto& stripe : _stripes) {
+            std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+            size += stripe.umap.size();
+        }
+        return size;
+    }
+
+    /// 逐段拷贝后再回调, 回调期间不持有任何锁, 可以在回调中读写本 map;
+    /// 回调拿到的是拷贝, 修改不会写回; 各分段的快照不是同一时刻的
+    void Enumerate(std::function<void(const K&, V&)> func) const
+    {
+        std::vector<std::pair<K, V>> items;
+        for (const auto& stripe : _stripes) {
+            items.clear();
+            {
+                std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+                items.reserve(stripe.umap.size());
+                for (const auto& item : stripe.umap) {
+                    items.emplace_back(item.first, item.second);
+                }
+            }
+            for (auto& item : items) {
+                func(item.first, item.second);
+            }
+        }
+    }
+
+    std::unordered_map<K, V, Hash> Snapshot() const
+    {
+        std::unordered_map<K, V, Hash> snapshot;
+        for (const auto& stripe : _stripes) {
+            std::shared_lock<std::shared_mutex> locker(stripe.mutex);
+            snapshot.insert(stripe.umap.begin(), stripe.umap.end());
+        }
+        return snapshot;
+    }
+
+    static constexpr size_t StripeCount()
+    {
+        return Stripes;
+    }
+
+private:
+    size_t IndexOf(const K& key) const
+    {
+        // 与 unordered_map 内部分桶使用同一个哈希, 取高位前先混合, 避免两者相关
+        const uint64_t hash = static_cast<uint64_t>(_hash(key)) * 0x9E3779B97F4A7C15ull;
+        return (hash >> 32) & (Stripes - 1);
+    }
+
+    Stripe& StripeOf(const K& key)
+    {
+        return _stripes[IndexOf(key)];
+    }
+
+    const Stripe& StripeOf(const K& key) const
+    {
+        return _stripes[IndexOf(key)];
+    }
+};
+
+}
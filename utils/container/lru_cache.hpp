@@ -2,18 +2,33 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <unordered_map>
 
+#include "time/time_utils.hpp"
+
 namespace xlab {
 
+/// 默认按条目数限制容量; SetMaxCost 后额外按每个条目 Put 时给出的代价(如字节数)限制总量.
+/// Put 可带 ttl, 过期条目在下次访问时惰性删除, 也可调用 PurgeExpired 主动清理
 template <typename K, typename V>
 struct LRUCache {
+public:
+    struct Statistic {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t expirations = 0;
+    };
+
 private:
     struct Node {
         K key;
         V val;
+        size_t cost = 1;
+        Time::Point expire = Time::Point::Max();
         Node* prev = nullptr;
         Node* next = nullptr;
 
@@ -22,12 +37,20 @@ private:
             , val(v)
         {
         }
+
+        bool HasExpired(const Time::Point& now) const
+        {
+            return expire != Time::Point::Max() && expire <= now;
+        }
     };
 
     using DeleteElementFunc = std::function<void(V)>;
 
     size_t _max_size;
     size_t _cur_size = 0;
+    size_t _max_cost = 0; // 0 表示不限制代价
+    size_t _cur_cost = 0;
+    std::atomic<size_t>* _shared_cost = nullptr; // 与其他缓存共用的代价合计, 如分片缓存的全局预算
     DeleteElementFunc _delete_func = nullptr;
 
     Node* head = nullptr;
@@ -35,6 +58,7 @@ private:
 
     std::unordered_map<K, Node*> _map;
     std::mutex _mutex;
+    Statistic _statistic;
 
 public:
     LRUCache(size_t max_size = 10, DeleteElementFunc delete_func = nullptr) noexcept
@@ -54,12 +78,16 @@ public:
         tail = lru.tail;
         _max_size = lru._max_size;
         _cur_size = lru._cur_size;
+        _max_cost = lru._max_cost;
+        _cur_cost = lru._cur_cost;
+        _shared_cost = lru._shared_cost;
         _map = std::move(lru._map);
         _delete_func = lru._delete_func;
 
         lru.head = nullptr;
         lru.tail = nullptr;
         lru._cur_size = 0;
+        lru._cur_cost = 0;
         lru._map.clear();
     }
 
@@ -81,13 +109,18 @@ public:
         tail = lru.tail;
         _max_size = lru._max_size;
         _cur_size = lru._cur_size;
+        _max_cost = lru._max_cost;
+        _cur_cost = lru._cur_cost;
+        _shared_cost = lru._shared_cost;
         _map = std::move(lru._map);
         _delete_func = lru._delete_func;
 
         lru.head = nullptr;
         lru.tail = nullptr;
         lru._cur_size = 0;
+        lru._cur_cost = 0;
         lru._map.clear();
+        return *this;
     }
 
 private:
@@ -131,6 +164,71 @@ private:
         head = node;
     }
 
+    /// 从链表和索引中摘除任意节点并释放
+    inline void EraseNodeWithoutLock(Node* node)
+    {
+        if (node->prev != nullptr) {
+            node->prev->next = node->next;
+        } else {
+            head = node->next;
+        }
+        if (node->next != nullptr) {
+            node->next->prev = node->prev;
+        } else {
+            tail = node->prev;
+        }
+        _cur_size -= 1;
+        SubCostWithoutLock(node->cost);
+        RemoveNodeWithoutLock(node);
+    }
+
+    inline void AddCostWithoutLock(size_t cost)
+    {
+        _cur_cost += cost;
+        if (_shared_cost != nullptr) {
+            _shared_cost->fetch_add(cost, std::memory_order_relaxed);
+        }
+    }
+
+    inline void SubCostWithoutLock(size_t cost)
+    {
+        _cur_cost -= cost;
+        if (_shared_cost != nullptr) {
+            _shared_cost->fetch_sub(cost, std::memory_order_relaxed);
+        }
+    }
+
+    inline bool OverBudgetWithoutLock(size_t incoming_cost) const
+    {
+        return _max_cost > 0 && _cur_cost + incoming_cost > _max_cost;
+    }
+
+    /// 从队尾淘汰直到满足条目数和代价限制, keep 节点不会被淘汰
+    inline void EvictWithoutLock(size_t incoming_count, size_t incoming_cost, Node* keep = nullptr)
+    {
+        while (tail != nullptr && tail != keep
+            && (_cur_size + incoming_count > _max_size || OverBudgetWithoutLock(incoming_cost))) {
+            EraseNodeWithoutLock(tail);
+            _statistic.evictions += 1;
+        }
+    }
+
+    /// 查找未过期的节点, 过期节点顺带删除
+    inline Node* FindAliveWithoutLock(const K& key)
+    {
+        auto iter = _map.find(key);
+        if (iter == _map.end()) {
+            return nullptr;
+        }
+        Node* node = iter->second;
+        if (node->expire != Time::Point::Max() && node->HasExpired(Time::Point::Now())) {
+            EraseNodeWithoutLock(node);
+            _statistic.expirations += 1;
+            return nullptr;
+        }
+        return node;
+    }
+
     inline void ClearWithoutLock()
     {
         auto node = head;
@@ -143,6 +241,7 @@ private:
         head = nullptr;
         tail = nullptr;
         _cur_size = 0;
+        SubCostWithoutLock(_cur_cost);
     }
 
 public:
@@ -152,33 +251,56 @@ public:
         ClearWithoutLock();
     }
 
-    void Put(const K& key, V& val)
+    /// 0 表示只按条目数限制; 调小时立即淘汰到预算以内
+    void SetMaxCost(size_t max_cost)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        _max_cost = max_cost;
+        EvictWithoutLock(0, 0);
+    }
+
+    /// 代价变化同时累加到 counter 上, 用于多个缓存共用一个预算; 需在放入条目前设置
+    void ShareCost(std::atomic<size_t>* counter)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        assert(_cur_size == 0);
+        _shared_cost = counter;
+    }
+
+    /// cost 仅在设置了 SetMaxCost 时生效, 单个条目超过总预算时不缓存并返回 false,
+    /// 此时 key 原有的值也被删除, 避免之后读到旧值; ttl 为零表示不过期
+    bool Put(const K& key, V& val, size_t cost = 1, const Time::Interval& ttl = Time::Interval::Zero())
     {
         std::lock_guard<decltype(_mutex)> locker(_mutex);
+        if (_max_cost > 0 && cost > _max_cost) {
+            auto iter = _map.find(key);
+            if (iter != _map.end()) {
+                EraseNodeWithoutLock(iter->second);
+            }
+            return false;
+        }
+
+        const auto expire = ttl > Time::Interval::Zero() ? Time::Point::Now() + ttl : Time::Point::Max();
         if (_map.find(key) != _map.end()) {
             Node* node = _map[key];
             if (_delete_func != nullptr) {
                 _delete_func(node->val);
             }
             node->val = val;
+            SubCostWithoutLock(node->cost);
+            AddCostWithoutLock(cost);
+            node->cost = cost;
+            node->expire = expire;
             MoveToHeadWithoutLock(node);
-            return;
+            EvictWithoutLock(0, 0, node);
+            return true;
         }
 
-        while (_cur_size >= _max_size) {
-            auto last = tail;
-            if (tail == nullptr) {
-                throw std::runtime_error("some error");
-            }
-            tail = tail->prev;
-            if (tail != nullptr) {
-                tail->next = nullptr;
-            }
-            RemoveNodeWithoutLock(last);
-            _cur_size -= 1;
-        }
+        EvictWithoutLock(1, cost);
 
         Node* node = new Node(key, val);
+        node->cost = cost;
+        node->expire = expire;
         if (_cur_size == 0) {
             head = node;
             tail = node;
@@ -189,36 +311,118 @@ public:
         }
         _map[key] = node;
         _cur_size += 1;
+        AddCostWithoutLock(cost);
+        return true;
+    }
+
+    bool Erase(const K& key)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        auto iter = _map.find(key);
+        if (iter == _map.end()) {
+            return false;
+        }
+        EraseNodeWithoutLock(iter->second);
+        return true;
+    }
+
+    /// 淘汰最久未使用的一个条目; 为空或队尾就是 keep 时不淘汰, 返回 false
+    bool EvictOldest(const K* keep = nullptr)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        if (tail == nullptr || (keep != nullptr && tail->key == *keep)) {
+            return false;
+        }
+        EraseNodeWithoutLock(tail);
+        _statistic.evictions += 1;
+        return true;
     }
 
     bool Find(const K& key)
     {
         std::lock_guard<decltype(_mutex)> locker(_mutex);
-        return _map.find(key) != _map.end();
+        return FindAliveWithoutLock(key) != nullptr;
     }
 
     V& Get(const K& key)
     {
         std::lock_guard<decltype(_mutex)> locker(_mutex);
-        if (_map.find(key) == _map.end()) {
+        Node* node = FindAliveWithoutLock(key);
+        if (node == nullptr) {
+            _statistic.misses += 1;
             throw std::runtime_error("no this key");
         }
-        Node* node = _map[key];
         MoveToHeadWithoutLock(node);
+        _statistic.hits += 1;
         return node->val;
     }
 
     bool TryGet(const K& key, V& val)
     {
         std::lock_guard<decltype(_mutex)> locker(_mutex);
-        if (_map.find(key) == _map.end()) {
+        Node* node = FindAliveWithoutLock(key);
+        if (node == nullptr) {
+            _statistic.misses += 1;
             return false;
         }
-        Node* node = _map[key];
         MoveToHeadWithoutLock(node);
         val = node->val;
+        _statistic.hits += 1;
         return true;
     }
+
+    size_t Size()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _cur_size;
+    }
+
+    size_t Capacity() const
+    {
+        return _max_size;
+    }
+
+    size_t Cost()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _cur_cost;
+    }
+
+    size_t MaxCost()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _max_cost;
+    }
+
+    /// 删除所有已过期的条目, 返回删除个数
+    size_t PurgeExpired()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        const auto now = Time::Point::Now();
+        size_t count = 0;
+        for (Node* node = head; node != nullptr;) {
+            Node* next = node->next;
+            if (node->HasExpired(now)) {
+                EraseNodeWithoutLock(node);
+                count += 1;
+            }
+            node = next;
+        }
+        _statistic.expirations += count;
+        return count;
+    }
+
+    Statistic GetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _statistic;
+    }
+
+    void ResetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        _statistic = Statistic();
+    }
 };
 
 }
@@ -103,15 +103,36 @@ public:
 
     size_t Size()
     {
+        std::shared_lock<decltype(mMutex)> locker(mMutex);
         return _umap.size();
     }
 
+    /// key 不存在时插入默认值并返回; 已存在时只持有共享锁
     V Get(const K& key)
     {
+        {
+            std::shared_lock<decltype(mMutex)> locker(mMutex);
+            auto iter = _umap.find(key);
+            if (iter != _umap.end()) {
+                return iter->second;
+            }
+        }
         std::lock_guard<decltype(mMutex)> locker(mMutex);
         return _umap[key];
     }
 
+    /// 与 Get 不同, key 不存在时不会插入
+    bool TryGet(const K& key, V& value)
+    {
+        std::shared_lock<decltype(mMutex)> locker(mMutex);
+        auto iter = _umap.find(key);
+        if (iter == _umap.end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
     // V &operator[](const K &key) {
     //     std::lock_guard<decltype(mMutex)> locker(mMutex);
     //     return _umap[key];
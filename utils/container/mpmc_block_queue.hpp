@@ -0,0 +1,404 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+
+#include "common/macro_conf.hpp"
+#include "semaphore/event_count.hpp"
+#include "time/time_utils.hpp"
+
+namespace xlab {
+
+/// 多生产者多消费者有界队列 (Vyukov 序号槽位), 入队出队无锁,
+/// 批量接口一次唤醒即可搬运多个元素, 只有在队列空/满时才会通过 futex 阻塞
+template <typename E>
+class MpmcBlockQueue {
+public:
+    using value_type = E;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+private:
+    MpmcBlockQueue(const MpmcBlockQueue&) = delete;
+
+    MpmcBlockQueue(MpmcBlockQueue&&) = delete;
+
+    MpmcBlockQueue& operator=(const MpmcBlockQueue&) = delete;
+
+    MpmcBlockQueue& operator=(MpmcBlockQueue&&) = delete;
+
+public:
+    /// 容量向上取整到 2 的幂
+    MpmcBlockQueue(size_t max = 64)
+        : mCapacity(RoundUpPowerOfTwo(max))
+        , mMask(mCapacity - 1)
+        , mCells(new Cell[mCapacity])
+    {
+        for (size_t i = 0; i < mCapacity; ++i) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcBlockQueue()
+    {
+        Clear();
+    }
+
+    size_t Capacity() const
+    {
+        return mCapacity;
+    }
+
+    bool TryPush(const E& element)
+    {
+        return Enqueue(element) && NotifyNotEmpty(1);
+    }
+
+    bool TryPush(E&& element)
+    {
+        return Enqueue(std::move(element)) && NotifyNotEmpty(1);
+    }
+
+    /// 队列满时阻塞, 被 Pulse 打断时返回 false
+    bool Push(const E& element)
+    {
+        return WaitEnqueue(Futex::Infinite(), element);
+    }
+
+    bool Push(E&& element)
+    {
+        return WaitEnqueue(Futex::Infinite(), std::move(element));
+    }
+
+    template <typename... Args>
+    bool TryEmplace(Args&&... args)
+    {
+        return Enqueue(std::forward<Args>(args)...) && NotifyNotEmpty(1);
+    }
+
+    template <typename... Args>
+    bool Emplace(Args&&... args)
+    {
+        return WaitEnqueue(Futex::Infinite(), std::forward<Args>(args)...);
+    }
+
+    /// 尽可能多地入队 [first, last), 不阻塞, 返回入队个数; 需要转移所有权时传入 std::make_move_iterator
+    template <typename InputIt>
+    size_t TryPushBatch(InputIt first, InputIt last)
+    {
+        size_t count = 0;
+        for (; first != last && Enqueue(*first); ++first) {
+            ++count;
+        }
+        NotifyNotEmpty(count);
+        return count;
+    }
+
+    /// 入队 [first, last) 全部元素, 队列满时阻塞, 返回入队个数 (被 Pulse 打断时小于 last - first)
+    template <typename InputIt>
+    size_t PushBatch(InputIt first, InputIt last)
+    {
+        size_t count = 0;
+        while (first != last) {
+            size_t pushed = 0;
+            for (; first != last && Enqueue(*first); ++first) {
+                ++pushed;
+            }
+            NotifyNotEmpty(pushed);
+            count += pushed;
+            if (first == last) {
+                break;
+            }
+            if (!WaitEnqueue(Futex::Infinite(), *first)) {
+                break;
+            }
+            ++first;
+            ++count;
+        }
+        return count;
+    }
+
+    std::optional<E> TryPop(const Time::Interval& wait_time)
+    {
+        return TryPop(wait_time.template ToChrono<ns>());
+    }
+
+    std::optional<E> TryPop(const std::chrono::nanoseconds& wait_time = std::chrono::nanoseconds::zero())
+    {
+        std::optional<E> front = std::nullopt;
+        WaitDequeue(wait_time, front);
+        return front;
+    }
+
+    /// 队列空时阻塞, 被 Pulse 打断时返回 std::nullopt
+    std::optional<E> Pop()
+    {
+        std::optional<E> front = std::nullopt;
+        WaitDequeue(Futex::Infinite(), front);
+        return front;
+    }
+
+    template <typename OutputIt>
+    size_t PopBatch(OutputIt out, size_t max, const Time::Interval& wait_time)
+    {
+        return PopBatch(out, max, wait_time.template ToChrono<ns>());
+    }
+
+    /// 最多等待 wait_time 直到有元素, 然后不再等待地一次取出至多 max 个元素, 返回取出个数
+    template <typename OutputIt>
+    size_t PopBatch(OutputIt out, size_t max, const std::chrono::nanoseconds& wait_time = std::chrono::nanoseconds::zero())
+    {
+        if (max == 0) {
+            return 0;
+        }
+
+        std::optional<E> element = std::nullopt;
+        if (!WaitDequeueWithoutNotify(wait_time, element)) {
+            return 0;
+        }
+
+        size_t count = 0;
+        do {
+            *out = std::move(*element);
+            ++out;
+            ++count;
+            element.reset();
+        } while (count < max && Dequeue(element));
+
+        mNotFull.Notify(static_cast<int>(count));
+        return count;
+    }
+
+    void Clear()
+    {
+        std::optional<E> element = std::nullopt;
+        size_t count = 0;
+        while (Dequeue(element)) {
+            element.reset();
+            ++count;
+        }
+        mNotFull.Notify(static_cast<int>(count));
+    }
+
+    void Reset()
+    {
+        Clear();
+        mNotFull.NotifyAll();
+    }
+
+    /// 让一个阻塞中(或之后第一个将要阻塞)的 Push 和一个 Pop 返回失败;
+    /// 与信号量一样, 没有等待者时保持有效直到被消耗, 队列非空/非满的调用不会消耗它
+    void Pulse()
+    {
+        mPulseIn.fetch_add(1, std::memory_order_release);
+        mPulseOut.fetch_add(1, std::memory_order_release);
+        mNotFull.NotifyAll();
+        mNotEmpty.NotifyAll();
+    }
+
+    size_t Size() const
+    {
+        const size_t head = mDequeuePos.load(std::memory_order_acquire);
+        const size_t tail = mEnqueuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool Empty() const
+    {
+        return Size() == 0;
+    }
+
+    bool Full() const
+    {
+        return Size() >= mCapacity;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(E) unsigned char data[sizeof(E)];
+
+        E* Element()
+        {
+            return std::launder(reinterpret_cast<E*>(data));
+        }
+    };
+
+    static size_t RoundUpPowerOfTwo(size_t value)
+    {
+        size_t capacity = 2;
+        while (capacity < value) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    bool NotifyNotEmpty(size_t count)
+    {
+        if (count > 0) {
+            mNotEmpty.Notify(static_cast<int>(count));
+        }
+        return true;
+    }
+
+    template <typename... Args>
+    bool Enqueue(Args&&... args)
+    {
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &mCells[pos & mMask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->Element()) E(std::forward<Args>(args)...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Dequeue(std::optional<E>& out)
+    {
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &mCells[pos & mMask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        E* element = cell->Element();
+        out.emplace(std::move(*element));
+        element->~E();
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename... Args>
+    bool WaitEnqueue(std::chrono::nanoseconds wait_time, Args&&... args)
+    {
+        if (Enqueue(std::forward<Args>(args)...)) {
+            return NotifyNotEmpty(1);
+        }
+
+        const auto deadline = Deadline(wait_time);
+        while (true) {
+            const auto remain = Remain(deadline);
+            if (remain <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+
+            const uint32_t key = mNotFull.PrepareWait();
+            if (Enqueue(std::forward<Args>(args)...)) {
+                mNotFull.CancelWait();
+                return NotifyNotEmpty(1);
+            }
+            if (ConsumePulse(mPulseIn)) {
+                mNotFull.CancelWait();
+                return false;
+            }
+            mNotFull.CommitWait(key, remain);
+        }
+    }
+
+    /// 只负责取出第一个元素, 出队后的 mNotFull 唤醒由调用方负责 (批量出队时合并唤醒)
+    bool WaitDequeueWithoutNotify(std::chrono::nanoseconds wait_time, std::optional<E>& out)
+    {
+        if (Dequeue(out)) {
+            return true;
+        }
+
+        const auto deadline = Deadline(wait_time);
+        while (true) {
+            const auto remain = Remain(deadline);
+            if (remain <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+
+            const uint32_t key = mNotEmpty.PrepareWait();
+            if (Dequeue(out)) {
+                mNotEmpty.CancelWait();
+                return true;
+            }
+            if (ConsumePulse(mPulseOut)) {
+                mNotEmpty.CancelWait();
+                return false;
+            }
+            mNotEmpty.CommitWait(key, remain);
+        }
+    }
+
+    bool WaitDequeue(std::chrono::nanoseconds wait_time, std::optional<E>& out)
+    {
+        if (!WaitDequeueWithoutNotify(wait_time, out)) {
+            return false;
+        }
+        mNotFull.Notify();
+        return true;
+    }
+
+    /// 取走一个未消耗的 Pulse
+    static bool ConsumePulse(std::atomic<uint32_t>& pulse)
+    {
+        uint32_t pending = pulse.load(std::memory_order_acquire);
+        while (pending > 0) {
+            if (pulse.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static std::chrono::steady_clock::time_point Deadline(std::chrono::nanoseconds wait_time)
+    {
+        if (wait_time == Futex::Infinite()) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return std::chrono::steady_clock::now() + wait_time;
+    }
+
+    static std::chrono::nanoseconds Remain(const std::chrono::steady_clock::time_point& deadline)
+    {
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            return Futex::Infinite();
+        }
+        return deadline - std::chrono::steady_clock::now();
+    }
+
+private:
+    const size_t mCapacity;
+    const size_t mMask;
+    std::unique_ptr<Cell[]> mCells;
+
+    alignas(XLAB_CACHE_LINE_SIZE) std::atomic<size_t> mEnqueuePos { 0 };
+    alignas(XLAB_CACHE_LINE_SIZE) std::atomic<size_t> mDequeuePos { 0 };
+
+    alignas(XLAB_CACHE_LINE_SIZE) EventCount mNotEmpty;
+    EventCount mNotFull;
+    std::atomic<uint32_t> mPulseIn { 0 };
+    std::atomic<uint32_t> mPulseOut { 0 };
+};
+
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "container/lru_cache.hpp"
+
+namespace xlab {
+
+/// 淘汰策略只管理 key 的顺序, 值由 PolicyCache 保存;
+/// 策略需要提供 OnInsert/OnHit/Evict/Clear, Evict 返回被淘汰的 key
+
+/// 最近最少使用, 命中即移到队头
+template <typename K>
+class LRUPolicy {
+public:
+    explicit LRUPolicy(size_t)
+    {
+    }
+
+    void OnInsert(const K& key)
+    {
+        _list.push_front(key);
+        _index[key] = _list.begin();
+    }
+
+    void OnHit(const K& key)
+    {
+        auto iter = _index.find(key);
+        if (iter == _index.end()) {
+            return;
+        }
+        _list.splice(_list.begin(), _list, iter->second);
+    }
+
+    K Evict()
+    {
+        K key = std::move(_list.back());
+        _list.pop_back();
+        _index.erase(key);
+        return key;
+    }
+
+    void Clear()
+    {
+        _list.clear();
+        _index.clear();
+    }
+
+private:
+    std::list<K> _list;
+    std::unordered_map<K, typename std::list<K>::iterator> _index;
+};
+
+/// S3-FIFO: 新 key 先进入约 10% 容量的小 FIFO, 在小 FIFO 中再次命中过的才晋升到主 FIFO,
+/// 其余直接淘汰并记入幽灵队列; 命中只增加计数而不移动节点, 一次性扫描不会冲掉主 FIFO 中的热点
+template <typename K>
+class S3FIFOPolicy {
+public:
+    explicit S3FIFOPolicy(size_t capacity)
+        : _small_capacity(std::max<size_t>(1, capacity / 10))
+        , _ghost_capacity(std::max<size_t>(1, capacity))
+    {
+    }
+
+    void OnInsert(const K& key)
+    {
+        auto ghost = _ghost_index.find(key);
+        if (ghost != _ghost_index.end()) {
+            _ghost.erase(ghost->second);
+            _ghost_index.erase(ghost);
+            _main.push_front(key);
+            _freq[key] = 0;
+            return;
+        }
+
+        _small.push_front(key);
+        _freq[key] = 0;
+    }
+
+    void OnHit(const K& key)
+    {
+        auto iter = _freq.find(key);
+        if (iter == _freq.end()) {
+            return;
+        }
+        iter->second = std::min<uint8_t>(iter->second + 1, FREQ_MAX);
+    }
+
+    K Evict()
+    {
+        while (true) {
+            if (_small.size() >= _small_capacity || _main.empty()) {
+                K key = std::move(_small.back());
+                _small.pop_back();
+                auto& freq = _freq[key];
+                if (freq > 0) {
+                    freq = 0;
+                    _main.push_front(key);
+                    continue;
+                }
+                _freq.erase(key);
+                AddGhost(key);
+                return key;
+            }
+
+            K key = std::move(_main.back());
+            _main.pop_back();
+            auto& freq = _freq[key];
+            if (freq > 0) {
+                freq -= 1;
+                _main.push_front(key);
+                continue;
+            }
+            _freq.erase(key);
+            return key;
+        }
+    }
+
+    void Clear()
+    {
+        _small.clear();
+        _main.clear();
+        _ghost.clear();
+        _ghost_index.clear();
+        _freq.clear();
+    }
+
+private:
+    static constexpr uint8_t FREQ_MAX = 3;
+
+    void AddGhost(const K& key)
+    {
+        _ghost.push_front(key);
+        _ghost_index[key] = _ghost.begin();
+        if (_ghost.size() > _ghost_capacity) {
+            _ghost_index.erase(_ghost.back());
+            _ghost.pop_back();
+        }
+    }
+
+    size_t _small_capacity;
+    size_t _ghost_capacity;
+    std::list<K> _small;
+    std::list<K> _main;
+    std::list<K> _ghost;
+    std::unordered_map<K, typename std::list<K>::iterator> _ghost_index;
+    std::unordered_map<K, uint8_t> _freq;
+};
+
+/// 与 LRUCache 接口一致, 淘汰策略可替换
+template <typename K, typename V, template <typename> class Policy = LRUPolicy>
+struct PolicyCache {
+public:
+    using Statistic = typename LRUCache<K, V>::Statistic;
+    using DeleteElementFunc = std::function<void(V)>;
+
+private:
+    size_t _max_size;
+    DeleteElementFunc _delete_func = nullptr;
+    Policy<K> _policy;
+    std::unordered_map<K, V> _map;
+    std::mutex _mutex;
+    Statistic _statistic;
+
+public:
+    PolicyCache(size_t max_size = 10, DeleteElementFunc delete_func = nullptr)
+        : _max_size(max_size)
+        , _delete_func(std::move(delete_func))
+        , _policy(max_size)
+    {
+        assert(max_size > 0);
+    }
+
+    PolicyCache(const PolicyCache&) = delete;
+
+    PolicyCache& operator=(const PolicyCache&) = delete;
+
+    ~PolicyCache()
+    {
+        ClearWithoutLock();
+    }
+
+private:
+    void ClearWithoutLock()
+    {
+        if (_delete_func != nullptr) {
+            for (auto& item : _map) {
+                _delete_func(item.second);
+            }
+        }
+        _map.clear();
+        _policy.Clear();
+    }
+
+public:
+    void Clear()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        ClearWithoutLock();
+    }
+
+    void Put(const K& key, V& val)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        auto iter = _map.find(key);
+        if (iter != _map.end()) {
+            if (_delete_func != nullptr) {
+                _delete_func(iter->second);
+            }
+            iter->second = val;
+            _policy.OnHit(key);
+            return;
+        }
+
+        while (_map.size() >= _max_size) {
+            auto victim = _map.find(_policy.Evict());
+            if (victim == _map.end()) {
+                throw std::runtime_error("some error");
+            }
+            if (_delete_func != nullptr) {
+                _delete_func(victim->second);
+            }
+            _map.erase(victim);
+            _statistic.evictions += 1;
+        }
+
+        _map.emplace(key, val);
+        _policy.OnInsert(key);
+    }
+
+    bool Find(const K& key)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _map.find(key) != _map.end();
+    }
+
+    V& Get(const K& key)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        auto iter = _map.find(key);
+        if (iter == _map.end()) {
+            _statistic.misses += 1;
+            throw std::runtime_error("no this key");
+        }
+        _policy.OnHit(key);
+        _statistic.hits += 1;
+        return iter->second;
+    }
+
+    bool TryGet(const K& key, V& val)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        auto iter = _map.find(key);
+        if (iter == _map.end()) {
+            _statistic.misses += 1;
+            return false;
+        }
+        _policy.OnHit(key);
+        val = iter->second;
+        _statistic.hits += 1;
+        return true;
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _map.size();
+    }
+
+    size_t Capacity() const
+    {
+        return _max_size;
+    }
+
+    Statistic GetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _statistic;
+    }
+
+    void ResetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        _statistic = Statistic();
+    }
+};
+
+template <typename K, typename V>
+using S3FIFOCache = PolicyCache<K, V, S3FIFOPolicy>;
+
+}
@@ -4,21 +4,37 @@
 #include <list>
 #include <mutex>
 #include <optional>
-#include <queue>
+
+#include "container/ring_buffer.hpp"
 
 namespace xlab {
 
-template <typename E>
+/// Container 为底层存储, 默认 RingBuffer 按队列高水位增长后不再分配; 也可指定 std::list<E>
+template <typename E, typename Container = RingBuffer<E>>
 class Queue {
 public:
+    using value_type = E;
+    using container_type = Container;
+
     Queue() = default;
 
     ~Queue() = default;
 
     void Push(const E& element)
+    {
+        Emplace(element);
+    }
+
+    void Push(E&& element)
+    {
+        Emplace(std::move(element));
+    }
+
+    template <typename... Args>
+    void Emplace(Args&&... args)
     {
         std::lock_guard<decltype(mMutex)> locker(mMutex);
-        mQueue.push(element);
+        mQueue.emplace_back(std::forward<Args>(args)...);
     }
 
     std::optional<E> Front()
@@ -37,8 +53,8 @@ public:
             return std::nullopt;
         }
 
-        auto front = std::make_optional(mQueue.front());
-        mQueue.pop();
+        auto front = std::make_optional(std::move(mQueue.front()));
+        mQueue.pop_front();
         return front;
     }
 
@@ -50,13 +66,9 @@ public:
             return std::nullopt;
         }
 
-        auto last = static_cast<E>(nullptr);
-        while (!mQueue.empty()) {
-            last = mQueue.front();
-            mQueue.pop();
-        }
-
-        return std::make_optional(last);
+        auto last = std::make_optional(std::move(mQueue.back()));
+        mQueue.clear();
+        return last;
     }
 
     /// 出队直至队尾, 返回队尾数据
@@ -68,7 +80,7 @@ public:
         }
 
         while (mQueue.size() > 1) {
-            mQueue.pop();
+            mQueue.pop_front();
         }
 
         return std::make_optional(mQueue.front());
@@ -77,7 +89,7 @@ public:
     void Clear()
     {
         std::lock_guard<decltype(mMutex)> locker(mMutex);
-        mQueue = decltype(mQueue)();
+        mQueue.clear();
     }
 
     size_t Size()
@@ -94,7 +106,7 @@ public:
 
 private:
     std::mutex mMutex;
-    std::queue<E, std::list<E>> mQueue;
+    Container mQueue;
 };
 
 }
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace xlab {
+
+/// 连续存储的环形缓冲, 容量按 2 的幂增长且不回收;
+/// 预留好容量后入队出队不再产生堆分配, 作为 Queue/BlockQueue 的默认存储
+template <typename E>
+class RingBuffer {
+public:
+    using value_type = E;
+    using size_type = size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    template <typename Owner, typename Value>
+    class basic_iterator {
+        friend class RingBuffer<E>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = E;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        basic_iterator() = default;
+
+        reference operator*() const { return *_owner->At(_index); }
+
+        pointer operator->() const { return _owner->At(_index); }
+
+        basic_iterator& operator++()
+        {
+            ++_index;
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator copy(*this);
+            ++_index;
+            return copy;
+        }
+
+        bool operator==(const basic_iterator& other) const
+        {
+            return _owner == other._owner && _index == other._index;
+        }
+
+        bool operator!=(const basic_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        basic_iterator(Owner* owner, size_t index)
+            : _owner(owner)
+            , _index(index)
+        {
+        }
+
+        Owner* _owner = nullptr;
+        size_t _index = 0;
+    };
+
+    using iterator = basic_iterator<RingBuffer, E>;
+    using const_iterator = basic_iterator<const RingBuffer, const E>;
+
+public:
+    RingBuffer() = default;
+
+    explicit RingBuffer(size_t capacity)
+    {
+        reserve(capacity);
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    RingBuffer(RingBuffer&& other) noexcept
+    {
+        swap(other);
+    }
+
+    RingBuffer& operator=(RingBuffer&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~RingBuffer()
+    {
+        clear();
+    }
+
+    void swap(RingBuffer& other) noexcept
+    {
+        std::swap(_slots, other._slots);
+        std::swap(_capacity, other._capacity);
+        std::swap(_head, other._head);
+        std::swap(_size, other._size);
+    }
+
+    iterator begin() { return iterator(this, 0); }
+
+    iterator end() { return iterator(this, _size); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+
+    const_iterator end() const { return const_iterator(this, _size); }
+
+    size_t size() const { return _size; }
+
+    size_t capacity() const { return _capacity; }
+
+    /// 容量按 2 的幂增长, 再翻倍就会溢出的上限
+    static constexpr size_t max_size() { return (std::numeric_limits<size_t>::max() / 2 + 1) / sizeof(Slot); }
+
+    bool empty() const { return _size == 0; }
+
+    reference front() { return *At(0); }
+
+    const_reference front() const { return *At(0); }
+
+    reference back() { return *At(_size - 1); }
+
+    const_reference back() const { return *At(_size - 1); }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity <= _capacity) {
+            return;
+        }
+
+        const size_t newCapacity = GrowCapacity(capacity);
+        std::unique_ptr<Slot[]> newSlots(new Slot[newCapacity]);
+        Relocate(newSlots, newCapacity);
+    }
+
+    void push_back(const E& element)
+    {
+        emplace_back(element);
+    }
+
+    void push_back(E&& element)
+    {
+        emplace_back(std::move(element));
+    }
+
+    template <typename... Args>
+    reference emplace_back(Args&&... args)
+    {
+        if (_size == _capacity) {
+            // 参数可能引用缓冲内的元素(如 push_back(front())), 先在新存储中构造新元素, 再搬移旧元素
+            const size_t newCapacity = GrowCapacity(_capacity + 1);
+            std::unique_ptr<Slot[]> newSlots(new Slot[newCapacity]);
+            E* element = new (newSlots[_size].data) E(std::forward<Args>(args)...);
+            try {
+                Relocate(newSlots, newCapacity);
+            } catch (...) {
+                element->~E();
+                throw;
+            }
+            ++_size;
+            return *element;
+        }
+        E* element = new (SlotAt(_size)) E(std::forward<Args>(args)...);
+        ++_size;
+        return *element;
+    }
+
+    void pop_front()
+    {
+        At(0)->~E();
+        _head = (_head + 1) & (_capacity - 1);
+        --_size;
+    }
+
+    void pop_back()
+    {
+        At(_size - 1)->~E();
+        --_size;
+    }
+
+    /// 删除 [first, last), 其后的元素前移; 配合 std::remove_if 实现原地条件删除
+    iterator erase(iterator first, iterator last)
+    {
+        const size_t from = first._index;
+        const size_t to = last._index;
+        if (from == to) {
+            return first;
+        }
+
+        size_t dst = from;
+        for (size_t src = to; src < _size; ++src, ++dst) {
+            *At(dst) = std::move(*At(src));
+        }
+        for (size_t i = dst; i < _size; ++i) {
+            At(i)->~E();
+        }
+        _size = dst;
+        return iterator(this, from);
+    }
+
+    /// 只析构元素, 保留已分配的容量
+    void clear()
+    {
+        while (_size > 0) {
+            pop_front();
+        }
+        _head = 0;
+    }
+
+private:
+    struct Slot {
+        alignas(E) unsigned char data[sizeof(E)];
+    };
+
+    /// 与 vector::reserve 一样, 超过 max_size 时抛 std::length_error
+    size_t GrowCapacity(size_t capacity) const
+    {
+        if (capacity > max_size()) {
+            throw std::length_error("RingBuffer capacity exceeds max_size()");
+        }
+        size_t newCapacity = _capacity == 0 ? 4 : _capacity;
+        while (newCapacity < capacity) {
+            newCapacity <<= 1;
+        }
+        return newCapacity;
+    }
+
+    /// 把现有元素按顺序移到 newSlots 的 [0, _size), 之后从下标 0 开始, 成功后接管 newSlots.
+    /// 与 vector 相同用 move_if_noexcept: 移动构造可能抛异常时改为拷贝, 中途抛异常则析构已构造的部分,
+    /// 原存储和 newSlots 的所有权都保持不变
+    void Relocate(std::unique_ptr<Slot[]>& newSlots, size_t newCapacity)
+    {
+        size_t count = 0;
+        try {
+            for (; count < _size; ++count) {
+                new (newSlots[count].data) E(std::move_if_noexcept(*At(count)));
+            }
+        } catch (...) {
+            while (count > 0) {
+                --count;
+                std::launder(reinterpret_cast<E*>(newSlots[count].data))->~E();
+            }
+            throw;
+        }
+        for (size_t i = 0; i < _size; ++i) {
+            At(i)->~E();
+        }
+
+        _slots = std::move(newSlots);
+        _capacity = newCapacity;
+        _head = 0;
+    }
+
+    void* SlotAt(size_t index) const
+    {
+        return _slots[(_head + index) & (_capacity - 1)].data;
+    }
+
+    E* At(size_t index) const
+    {
+        return std::launder(reinterpret_cast<E*>(SlotAt(index)));
+    }
+
+private:
+    std::unique_ptr<Slot[]> _slots;
+    size_t _capacity = 0;
+    size_t _head = 0;
+    size_t _size = 0;
+};
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "common/macro_conf.hpp"
+#include "container/lru_cache.hpp"
+
+namespace xlab {
+
+/// 按 key 的哈希分片的 LRUCache, 每个分片独立加锁, 不同分片的访问互不阻塞;
+/// 条目数容量按分片平均分配, 是近似的全局容量; 代价预算是全局的, 超出时轮流淘汰各分片最旧的条目
+template <typename K, typename V, size_t Shards = 16, typename Hash = std::hash<K>>
+struct ShardedLRUCache {
+    static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "ShardedLRUCache `Shards` must be a power of two");
+
+public:
+    using Cache = LRUCache<K, V>;
+    using Statistic = typename Cache::Statistic;
+    using DeleteElementFunc = std::function<void(V)>;
+
+private:
+    struct alignas(XLAB_CACHE_LINE_SIZE) Shard {
+        Cache cache;
+
+        Shard(size_t max_size, DeleteElementFunc delete_func)
+            : cache(max_size, std::move(delete_func))
+        {
+        }
+    };
+
+    std::array<std::unique_ptr<Shard>, Shards> _shards;
+    Hash _hash;
+    std::atomic<size_t> _max_cost { 0 };
+    std::atomic<size_t> _cur_cost { 0 };
+    std::atomic<size_t> _evict_cursor { 0 };
+
+public:
+    ShardedLRUCache(size_t max_size = 10 * Shards, DeleteElementFunc delete_func = nullptr)
+    {
+        const size_t shard_size = std::max<size_t>(1, (max_size + Shards - 1) / Shards);
+        for (auto& shard : _shards) {
+            shard = std::make_unique<Shard>(shard_size, delete_func);
+            shard->cache.ShareCost(&_cur_cost);
+        }
+    }
+
+    ShardedLRUCache(const ShardedLRUCache&) = delete;
+
+    ShardedLRUCache& operator=(const ShardedLRUCache&) = delete;
+
+    ~ShardedLRUCache() = default;
+
+public:
+    void Clear()
+    {
+        for (auto& shard : _shards) {
+            shard->cache.Clear();
+        }
+    }
+
+    /// 0 表示只按条目数限制; 调小时立即淘汰到预算以内
+    void SetMaxCost(size_t max_cost)
+    {
+        _max_cost.store(max_cost, std::memory_order_relaxed);
+        EvictOverBudget(nullptr);
+    }
+
+    /// 单个条目超过全局预算时不缓存并返回 false, key 原有的值也被删除
+    bool Put(const K& key, V& val, size_t cost = 1, const Time::Interval& ttl = Time::Interval::Zero())
+    {
+        Cache& shard = ShardOf(key);
+        const size_t max_cost = _max_cost.load(std::memory_order_relaxed);
+        if (max_cost > 0 && cost > max_cost) {
+            shard.Erase(key);
+            return false;
+        }
+        shard.Put(key, val, cost, ttl);
+        EvictOverBudget(&key);
+        return true;
+    }
+
+    bool Erase(const K& key)
+    {
+        return ShardOf(key).Erase(key);
+    }
+
+    bool Find(const K& key)
+    {
+        return ShardOf(key).Find(key);
+    }
+
+    V& Get(const K& key)
+    {
+        return ShardOf(key).Get(key);
+    }
+
+    bool TryGet(const K& key, V& val)
+    {
+        return ShardOf(key).TryGet(key, val);
+    }
+
+    size_t Size()
+    {
+        size_t size = 0;
+        for (auto& shard : _shards) {
+            size += shard->cache.Size();
+        }
+        return size;
+    }
+
+    size_t Capacity() const
+    {
+        return _shards[0]->cache.Capacity() * Shards;
+    }
+
+    static constexpr size_t ShardCount()
+    {
+        return Shards;
+    }
+
+    Statistic GetShardStatistic(size_t index)
+    {
+        return _shards[index & (Shards - 1)]->cache.GetStatistic();
+    }
+
+    Statistic GetStatistic()
+    {
+        Statistic total;
+        for (auto& shard : _shards) {
+            const auto statistic = shard->cache.GetStatistic();
+            total.hits += statistic.hits;
+            total.misses += statistic.misses;
+            total.evictions += statistic.evictions;
+            total.expirations += statistic.expirations;
+        }
+        return total;
+    }
+
+    size_t Cost() const
+    {
+        return _cur_cost.load(std::memory_order_relaxed);
+    }
+
+    size_t MaxCost() const
+    {
+        return _max_cost.load(std::memory_order_relaxed);
+    }
+
+    size_t PurgeExpired()
+    {
+        size_t count = 0;
+        for (auto& shard : _shards) {
+            count += shard->cache.PurgeExpired();
+        }
+        return count;
+    }
+
+    void ResetStatistic()
+    {
+        for (auto& shard : _shards) {
+            shard->cache.ResetStatistic();
+        }
+    }
+
+private:
+    /// 从游标处的分片开始轮流淘汰最旧的条目直到回到预算以内, 刚放入的 keep 不会被淘汰;
+    /// 只在单个分片内按 LRU 顺序, 分片之间是近似的
+    void EvictOverBudget(const K* keep)
+    {
+        size_t idle = 0;
+        while (idle < Shards) {
+            const size_t max_cost = _max_cost.load(std::memory_order_relaxed);
+            if (max_cost == 0 || _cur_cost.load(std::memory_order_relaxed) <= max_cost) {
+                return;
+            }
+            const size_t index = _evict_cursor.fetch_add(1, std::memory_order_relaxed) & (Shards - 1);
+            idle = _shards[index]->cache.EvictOldest(keep) ? 0 : idle + 1;
+        }
+    }
+
+    Cache& ShardOf(const K& key)
+    {
+        // std::hash 对整数是恒等映射, 取高位前先混合一次, 避免连续 id 只落在少数分片
+        const uint64_t hash = static_cast<uint64_t>(_hash(key)) * 0x9E3779B97F4A7C15ull;
+        return _shards[(hash >> 32) & (Shards - 1)]->cache;
+    }
+};
+
+}
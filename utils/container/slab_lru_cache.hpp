@@ -0,0 +1,301 @@
+#pragma once
+
+#include <assert.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "container/lru_cache.hpp"
+
+namespace xlab {
+
+/// 与 LRUCache 接口一致, 但节点在构造时一次性分配在连续的 slab 中, 链表用下标串联,
+/// 索引为线性探测的开放寻址表; 缓存写满后淘汰/插入不再产生任何堆分配, 每次查找只有一次探测.
+/// K/V 需要可默认构造和赋值
+template <typename K, typename V, typename Hash = std::hash<K>>
+struct SlabLRUCache {
+public:
+    using Statistic = typename LRUCache<K, V>::Statistic;
+    using DeleteElementFunc = std::function<void(V)>;
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        K key {};
+        V val {};
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+    };
+
+    struct Slot {
+        uint32_t node = NIL;
+        uint32_t hash = 0;
+    };
+
+    size_t _max_size;
+    size_t _cur_size = 0;
+    DeleteElementFunc _delete_func = nullptr;
+
+    std::vector<Node> _nodes;
+    uint32_t _free = NIL;
+    uint32_t head = NIL;
+    uint32_t tail = NIL;
+
+    std::vector<Slot> _table;
+    size_t _mask = 0;
+
+    Hash _hash;
+    std::mutex _mutex;
+    Statistic _statistic;
+
+public:
+    SlabLRUCache(size_t max_size = 10, DeleteElementFunc delete_func = nullptr)
+        : _max_size(max_size)
+        , _delete_func(std::move(delete_func))
+        , _nodes(max_size)
+    {
+        assert(max_size > 0 && max_size < NIL);
+
+        size_t table_size = 4;
+        while (table_size < max_size * 2) {
+            table_size <<= 1;
+        }
+        _table.resize(table_size);
+        _mask = table_size - 1;
+
+        ResetFreeListWithoutLock();
+    }
+
+    SlabLRUCache(const SlabLRUCache&) = delete;
+
+    SlabLRUCache& operator=(const SlabLRUCache&) = delete;
+
+    ~SlabLRUCache()
+    {
+        ClearWithoutLock();
+    }
+
+private:
+    uint32_t HashOf(const K& key) const
+    {
+        const uint64_t hash = static_cast<uint64_t>(_hash(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(hash >> 32);
+    }
+
+    /// 返回 key 所在的槽位, 不存在时返回可插入的空槽位
+    size_t ProbeWithoutLock(const K& key, uint32_t hash) const
+    {
+        size_t index = hash & _mask;
+        while (_table[index].node != NIL) {
+            const auto& slot = _table[index];
+            if (slot.hash == hash && _nodes[slot.node].key == key) {
+                return index;
+            }
+            index = (index + 1) & _mask;
+        }
+        return index;
+    }
+
+    /// 线性探测的回移删除, 不留墓碑
+    void EraseSlotWithoutLock(size_t index)
+    {
+        size_t next = index;
+        while (true) {
+            next = (next + 1) & _mask;
+            if (_table[next].node == NIL) {
+                break;
+            }
+            const size_t home = _table[next].hash & _mask;
+            const bool stay = index <= next ? (index < home && home <= next) : (index < home || home <= next);
+            if (stay) {
+                continue;
+            }
+            _table[index] = _table[next];
+            index = next;
+        }
+        _table[index].node = NIL;
+    }
+
+    void UnlinkWithoutLock(uint32_t index)
+    {
+        Node& node = _nodes[index];
+        if (node.prev != NIL) {
+            _nodes[node.prev].next = node.next;
+        } else {
+            head = node.next;
+        }
+        if (node.next != NIL) {
+            _nodes[node.next].prev = node.prev;
+        } else {
+            tail = node.prev;
+        }
+        node.prev = NIL;
+        node.next = NIL;
+    }
+
+    void LinkHeadWithoutLock(uint32_t index)
+    {
+        Node& node = _nodes[index];
+        node.prev = NIL;
+        node.next = head;
+        if (head != NIL) {
+            _nodes[head].prev = index;
+        }
+        head = index;
+        if (tail == NIL) {
+            tail = index;
+        }
+    }
+
+    void MoveToHeadWithoutLock(uint32_t index)
+    {
+        if (index == head) {
+            return;
+        }
+        UnlinkWithoutLock(index);
+        LinkHeadWithoutLock(index);
+    }
+
+    /// 淘汰队尾节点, 返回空出来的节点下标
+    uint32_t EvictTailWithoutLock()
+    {
+        const uint32_t index = tail;
+        Node& node = _nodes[index];
+        EraseSlotWithoutLock(ProbeWithoutLock(node.key, HashOf(node.key)));
+        UnlinkWithoutLock(index);
+        if (_delete_func != nullptr) {
+            _delete_func(node.val);
+        }
+        _cur_size -= 1;
+        _statistic.evictions += 1;
+        return index;
+    }
+
+    void ResetFreeListWithoutLock()
+    {
+        for (size_t i = 0; i < _nodes.size(); ++i) {
+            _nodes[i].prev = NIL;
+            _nodes[i].next = i + 1 < _nodes.size() ? static_cast<uint32_t>(i + 1) : NIL;
+        }
+        _free = _nodes.empty() ? NIL : 0;
+    }
+
+    inline void ClearWithoutLock()
+    {
+        for (uint32_t index = head; index != NIL; index = _nodes[index].next) {
+            if (_delete_func != nullptr) {
+                _delete_func(_nodes[index].val);
+            }
+            _nodes[index].key = K {};
+            _nodes[index].val = V {};
+        }
+        for (auto& slot : _table) {
+            slot.node = NIL;
+        }
+        head = NIL;
+        tail = NIL;
+        _cur_size = 0;
+        ResetFreeListWithoutLock();
+    }
+
+public:
+    void Clear()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        ClearWithoutLock();
+    }
+
+    void Put(const K& key, const V& val)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        const uint32_t hash = HashOf(key);
+        size_t slot = ProbeWithoutLock(key, hash);
+        if (_table[slot].node != NIL) {
+            Node& node = _nodes[_table[slot].node];
+            if (_delete_func != nullptr) {
+                _delete_func(node.val);
+            }
+            node.val = val;
+            MoveToHeadWithoutLock(_table[slot].node);
+            return;
+        }
+
+        uint32_t index = NIL;
+        if (_cur_size >= _max_size) {
+            index = EvictTailWithoutLock();
+            // 回移删除可能挪动了探测链, 重新定位插入位置
+            slot = ProbeWithoutLock(key, hash);
+        } else {
+            index = _free;
+            _free = _nodes[index].next;
+        }
+
+        Node& node = _nodes[index];
+        node.key = key;
+        node.val = val;
+        LinkHeadWithoutLock(index);
+        _table[slot] = { index, hash };
+        _cur_size += 1;
+    }
+
+    bool Find(const K& key)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _table[ProbeWithoutLock(key, HashOf(key))].node != NIL;
+    }
+
+    V& Get(const K& key)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        const uint32_t index = _table[ProbeWithoutLock(key, HashOf(key))].node;
+        if (index == NIL) {
+            _statistic.misses += 1;
+            throw std::runtime_error("no this key");
+        }
+        MoveToHeadWithoutLock(index);
+        _statistic.hits += 1;
+        return _nodes[index].val;
+    }
+
+    bool TryGet(const K& key, V& val)
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        const uint32_t index = _table[ProbeWithoutLock(key, HashOf(key))].node;
+        if (index == NIL) {
+            _statistic.misses += 1;
+            return false;
+        }
+        MoveToHeadWithoutLock(index);
+        val = _nodes[index].val;
+        _statistic.hits += 1;
+        return true;
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _cur_size;
+    }
+
+    size_t Capacity() const
+    {
+        return _max_size;
+    }
+
+    Statistic GetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        return _statistic;
+    }
+
+    void ResetStatistic()
+    {
+        std::lock_guard<decltype(_mutex)> locker(_mutex);
+        _statistic = Statistic();
+    }
+};
+
+}
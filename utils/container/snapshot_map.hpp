@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace xlab {
+
+/// 读多写少的注册表: 读者拿到的是不可变的快照, 写者拷贝整表修改后原子地发布新版本(RCU);
+/// 旧快照在最后一个持有者释放后回收. 写操作是 O(n) 的, 只适合每分钟几次的更新频率.
+/// 取快照要在一个短小的锁内拷贝 shared_ptr, 热路径上的读者应使用 Reader, 版本不变时只读一个原子量
+template <typename K, typename V>
+class SnapshotMap {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using map_type = std::unordered_map<K, V>;
+    using Snapshot = std::shared_ptr<const map_type>;
+
+    /// 每个读线程持有一个, 版本号不变时直接复用缓存的快照, 不加锁也不触碰共享的引用计数,
+    /// 只有版本变化后的第一次读取才去取新快照; Reader 本身不是线程安全的
+    class Reader {
+    public:
+        explicit Reader(const SnapshotMap& map)
+            : _map(map)
+        {
+        }
+
+        const map_type& Get()
+        {
+            const uint64_t version = _map._version.load(std::memory_order_acquire);
+            if (_snapshot == nullptr || version != _version) {
+                _snapshot = _map.GetSnapshot();
+                _version = version;
+            }
+            return *_snapshot;
+        }
+
+        bool TryGet(const K& key, V& value)
+        {
+            const auto& umap = Get();
+            auto iter = umap.find(key);
+            if (iter == umap.end()) {
+                return false;
+            }
+            value = iter->second;
+            return true;
+        }
+
+    private:
+        const SnapshotMap& _map;
+        Snapshot _snapshot;
+        uint64_t _version = 0;
+    };
+
+private:
+    // std::atomic_load(shared_ptr) 在多数实现上也是全局锁池, 这里直接用一把只保护指针拷贝的锁
+    Snapshot _snapshot = std::make_shared<const map_type>();
+    mutable std::mutex _snapshotMutex;
+    std::atomic<uint64_t> _version { 0 };
+    std::mutex _writeMutex;
+
+public:
+    SnapshotMap() = default;
+
+    SnapshotMap(const SnapshotMap&) = delete;
+
+    SnapshotMap& operator=(const SnapshotMap&) = delete;
+
+private:
+    /// 在写锁内拷贝当前版本, 交给 func 修改后发布; func 返回 false 时放弃本次修改
+    bool Publish(const std::function<bool(map_type&)>& func)
+    {
+        std::lock_guard<decltype(_writeMutex)> locker(_writeMutex);
+        auto next = std::make_shared<map_type>(*GetSnapshot());
+        if (!func(*next)) {
+            return false;
+        }
+        Store(std::move(next));
+        return true;
+    }
+
+    /// 先换指针再加版本号, 读者看到新版本号时一定能取到不旧于它的快照;
+    /// 旧快照在锁外释放, 避免析构整表时挡住读者
+    void Store(Snapshot next)
+    {
+        {
+            std::lock_guard<decltype(_snapshotMutex)> locker(_snapshotMutex);
+            _snapshot.swap(next);
+        }
+        _version.fetch_add(1, std::memory_order_release);
+    }
+
+public:
+    Snapshot GetSnapshot() const
+    {
+        std::lock_guard<decltype(_snapshotMutex)> locker(_snapshotMutex);
+        return _snapshot;
+    }
+
+    /// 每次发布新快照加一
+    uint64_t Version() const
+    {
+        return _version.load(std::memory_order_acquire);
+    }
+
+    void Set(const K& key, const V& value)
+    {
+        Publish([&](map_type& umap) {
+            umap[key] = value;
+            return true;
+        });
+    }
+
+    bool Erase(const K& key)
+    {
+        return Publish([&](map_type& umap) {
+            return umap.erase(key) > 0;
+        });
+    }
+
+    void Clear()
+    {
+        std::lock_guard<decltype(_writeMutex)> locker(_writeMutex);
+        Store(std::make_shared<const map_type>());
+    }
+
+    /// 批量修改只拷贝一次, 读者要么看到全部修改要么一个都看不到
+    void Update(const std::function<void(map_type&)>& func)
+    {
+        Publish([&](map_type& umap) {
+            func(umap);
+            return true;
+        });
+    }
+
+    bool Find(const K& key) const
+    {
+        const auto snapshot = GetSnapshot();
+        return snapshot->find(key) != snapshot->end();
+    }
+
+    bool TryGet(const K& key, V& value) const
+    {
+        const auto snapshot = GetSnapshot();
+        auto iter = snapshot->find(key);
+        if (iter == snapshot->end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    /// 不存在时返回值初始化的 V
+    V GetOrNull(const K& key) const
+    {
+        const auto snapshot = GetSnapshot();
+        auto iter = snapshot->find(key);
+        return iter == snapshot->end() ? V {} : iter->second;
+    }
+
+    size_t Size() const
+    {
+        return GetSnapshot()->size();
+    }
+
+    /// 遍历调用时刻的快照, 不持有任何锁, 回调中可以修改本 map(修改对本次遍历不可见)
+    void Enumerate(const std::function<void(const K&, const V&)>& func) const
+    {
+        const auto snapshot = GetSnapshot();
+        for (const auto& item : *snapshot) {
+            func(item.first, item.second);
+        }
+    }
+};
+
+}
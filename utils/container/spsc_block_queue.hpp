@@ -0,0 +1,311 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+
+#include "common/macro_conf.hpp"
+#include "semaphore/event_count.hpp"
+#include "time/time_utils.hpp"
+
+namespace xlab {
+
+/// 单生产者单消费者有界队列, 预分配 N 个槽位的环形缓冲, 入队出队无锁,
+/// 只有在队列空/满时才会通过 futex 阻塞
+template <typename E, size_t N>
+class SpscBlockQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscBlockQueue capacity `N` must be a power of two");
+
+public:
+    using value_type = E;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+private:
+    SpscBlockQueue(const SpscBlockQueue&) = delete;
+
+    SpscBlockQueue(SpscBlockQueue&&) = delete;
+
+    SpscBlockQueue& operator=(const SpscBlockQueue&) = delete;
+
+    SpscBlockQueue& operator=(SpscBlockQueue&&) = delete;
+
+public:
+    SpscBlockQueue()
+        : mSlots(new Slot[N])
+    {
+    }
+
+    ~SpscBlockQueue()
+    {
+        DestroyAll();
+    }
+
+    static constexpr size_t Capacity()
+    {
+        return N;
+    }
+
+    /// 以下入队接口只允许在生产者线程调用
+
+    bool TryPush(const E& element)
+    {
+        return Enqueue(element);
+    }
+
+    bool TryPush(E&& element)
+    {
+        return Enqueue(std::move(element));
+    }
+
+    /// 队列满时阻塞, 被 Pulse 打断时返回 false
+    bool Push(const E& element)
+    {
+        return WaitEnqueue(Futex::Infinite(), element);
+    }
+
+    bool Push(E&& element)
+    {
+        return WaitEnqueue(Futex::Infinite(), std::move(element));
+    }
+
+    template <typename... Args>
+    bool TryEmplace(Args&&... args)
+    {
+        return Enqueue(std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool Emplace(Args&&... args)
+    {
+        return WaitEnqueue(Futex::Infinite(), std::forward<Args>(args)...);
+    }
+
+    /// 以下出队接口只允许在消费者线程调用
+
+    std::optional<E> TryPop(const Time::Interval& wait_time)
+    {
+        return TryPop(wait_time.template ToChrono<ns>());
+    }
+
+    std::optional<E> TryPop(const std::chrono::nanoseconds& wait_time = std::chrono::nanoseconds::zero())
+    {
+        std::optional<E> front = std::nullopt;
+        WaitDequeue(wait_time, front);
+        return front;
+    }
+
+    /// 队列空时阻塞, 被 Pulse 打断时返回 std::nullopt
+    std::optional<E> Pop()
+    {
+        std::optional<E> front = std::nullopt;
+        WaitDequeue(Futex::Infinite(), front);
+        return front;
+    }
+
+    std::optional<E> Front()
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        return std::make_optional(*SlotAt(head));
+    }
+
+    void Clear()
+    {
+        auto ret = TryPop();
+        while (ret.has_value()) {
+            ret = TryPop();
+        }
+    }
+
+    /// 清空队列; 与 Clear 一样只允许在消费者线程调用
+    void Reset()
+    {
+        Clear();
+        mNotFull.NotifyAll();
+    }
+
+    /// 让一个阻塞中(或之后第一个将要阻塞)的 Push 和一个 Pop 返回失败;
+    /// 与信号量一样, 没有等待者时保持有效直到被消耗, 队列非空/非满的调用不会消耗它
+    void Pulse()
+    {
+        mPulseIn.fetch_add(1, std::memory_order_release);
+        mPulseOut.fetch_add(1, std::memory_order_release);
+        mNotFull.NotifyAll();
+        mNotEmpty.NotifyAll();
+    }
+
+    size_t Size() const
+    {
+        const size_t head = mHead.load(std::memory_order_acquire);
+        const size_t tail = mTail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    bool Empty() const
+    {
+        return Size() == 0;
+    }
+
+    bool Full() const
+    {
+        return Size() >= N;
+    }
+
+private:
+    struct Slot {
+        alignas(E) unsigned char data[sizeof(E)];
+    };
+
+    E* SlotAt(size_t pos) const
+    {
+        return std::launder(reinterpret_cast<E*>(mSlots[pos & (N - 1)].data));
+    }
+
+    template <typename... Args>
+    bool Enqueue(Args&&... args)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHeadCache >= N) {
+            mHeadCache = mHead.load(std::memory_order_acquire);
+            if (tail - mHeadCache >= N) {
+                return false;
+            }
+        }
+
+        new (SlotAt(tail)) E(std::forward<Args>(args)...);
+        mTail.store(tail + 1, std::memory_order_release);
+        mNotEmpty.Notify();
+        return true;
+    }
+
+    bool Dequeue(std::optional<E>& out)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTailCache) {
+            mTailCache = mTail.load(std::memory_order_acquire);
+            if (head == mTailCache) {
+                return false;
+            }
+        }
+
+        E* element = SlotAt(head);
+        out.emplace(std::move(*element));
+        element->~E();
+        mHead.store(head + 1, std::memory_order_release);
+        mNotFull.Notify();
+        return true;
+    }
+
+    template <typename... Args>
+    bool WaitEnqueue(std::chrono::nanoseconds wait_time, Args&&... args)
+    {
+        if (Enqueue(std::forward<Args>(args)...)) {
+            return true;
+        }
+
+        const auto deadline = Deadline(wait_time);
+        while (true) {
+            const auto remain = Remain(deadline);
+            if (remain <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+
+            const uint32_t key = mNotFull.PrepareWait();
+            if (Enqueue(std::forward<Args>(args)...)) {
+                mNotFull.CancelWait();
+                return true;
+            }
+            if (ConsumePulse(mPulseIn)) {
+                mNotFull.CancelWait();
+                return false;
+            }
+            mNotFull.CommitWait(key, remain);
+        }
+    }
+
+    bool WaitDequeue(std::chrono::nanoseconds wait_time, std::optional<E>& out)
+    {
+        if (Dequeue(out)) {
+            return true;
+        }
+
+        const auto deadline = Deadline(wait_time);
+        while (true) {
+            const auto remain = Remain(deadline);
+            if (remain <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+
+            const uint32_t key = mNotEmpty.PrepareWait();
+            if (Dequeue(out)) {
+                mNotEmpty.CancelWait();
+                return true;
+            }
+            if (ConsumePulse(mPulseOut)) {
+                mNotEmpty.CancelWait();
+                return false;
+            }
+            mNotEmpty.CommitWait(key, remain);
+        }
+    }
+
+    /// 取走一个未消耗的 Pulse
+    static bool ConsumePulse(std::atomic<uint32_t>& pulse)
+    {
+        uint32_t pending = pulse.load(std::memory_order_acquire);
+        while (pending > 0) {
+            if (pulse.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static std::chrono::steady_clock::time_point Deadline(std::chrono::nanoseconds wait_time)
+    {
+        if (wait_time == Futex::Infinite()) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return std::chrono::steady_clock::now() + wait_time;
+    }
+
+    static std::chrono::nanoseconds Remain(const std::chrono::steady_clock::time_point& deadline)
+    {
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            return Futex::Infinite();
+        }
+        return deadline - std::chrono::steady_clock::now();
+    }
+
+    void DestroyAll()
+    {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        for (; head != tail; ++head) {
+            SlotAt(head)->~E();
+        }
+        mHead.store(head, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<Slot[]> mSlots;
+
+    alignas(XLAB_CACHE_LINE_SIZE) std::atomic<size_t> mHead { 0 };
+    size_t mTailCache = 0;
+
+    alignas(XLAB_CACHE_LINE_SIZE) std::atomic<size_t> mTail { 0 };
+    size_t mHeadCache = 0;
+
+    alignas(XLAB_CACHE_LINE_SIZE) EventCount mNotEmpty;
+    EventCount mNotFull;
+    std::atomic<uint32_t> mPulseIn { 0 };
+    std::atomic<uint32_t> mPulseOut { 0 };
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "semaphore/futex.hpp"
+
+namespace xlab {
+
+/// 无锁结构的阻塞辅助: 条件不满足时 PrepareWait -> 再次检查条件 -> CommitWait/CancelWait,
+/// 条件变化方在发布数据之后调用 Notify, 没有等待者时只有一次内存屏障和一次读
+class EventCount {
+private:
+    EventCount(const EventCount&) = delete;
+
+    EventCount& operator=(const EventCount&) = delete;
+
+public:
+    EventCount() = default;
+
+    ~EventCount() = default;
+
+    uint32_t PrepareWait()
+    {
+        mWaiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return mEpoch.load(std::memory_order_acquire);
+    }
+
+    void CancelWait()
+    {
+        mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void CommitWait(uint32_t key, std::chrono::nanoseconds timeout = Futex::Infinite())
+    {
+        Futex::Wait(mEpoch, key, timeout);
+        mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Notify(int count = 1)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        mEpoch.fetch_add(1, std::memory_order_release);
+        Futex::Wake(mEpoch, count);
+    }
+
+    void NotifyAll()
+    {
+        Notify(INT_MAX);
+    }
+
+private:
+    Futex::word_type mEpoch { 0 };
+    std::atomic<int32_t> mWaiters { 0 };
+};
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#if defined(__linux__) || defined(__ANDROID__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#define XLAB_HAVE_FUTEX 1
+#else
+#define XLAB_HAVE_FUTEX 0
+#endif
+
+namespace xlab {
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/// 32位原子字上的等待/唤醒, Linux/Android 下直接使用 futex;
+/// 其他平台的无限等待在 C++20 下使用 std::atomic::wait, 其余情况退化为按地址分桶的条件变量
+struct Futex {
+    using word_type = std::atomic<uint32_t>;
+
+    static constexpr std::chrono::nanoseconds Infinite()
+    {
+        return std::chrono::nanoseconds::max();
+    }
+
+    /// word == expected 时阻塞, 直到被唤醒或超时; 可能虚假返回, 调用方需要重新检查条件
+    static void Wait(word_type& word, uint32_t expected, std::chrono::nanoseconds timeout = Infinite())
+    {
+        if (timeout <= std::chrono::nanoseconds::zero()) {
+            return;
+        }
+
+#if XLAB_HAVE_FUTEX
+        struct timespec ts;
+        struct timespec* pts = nullptr;
+        if (timeout != Infinite()) {
+            ts.tv_sec = static_cast<time_t>(timeout.count() / 1'000'000'000);
+            ts.tv_nsec = static_cast<long>(timeout.count() % 1'000'000'000);
+            pts = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+#else
+#if defined(__cpp_lib_atomic_wait)
+        if (timeout == Infinite()) {
+            word.wait(expected, std::memory_order_acquire);
+            return;
+        }
+#endif
+        auto& bucket = BucketOf(&word);
+        std::unique_lock<std::mutex> lock { bucket.mutex };
+        if (word.load(std::memory_order_acquire) != expected) {
+            return;
+        }
+        if (timeout == Infinite()) {
+            bucket.condVar.wait(lock);
+        } else {
+            bucket.condVar.wait_for(lock, timeout);
+        }
+#endif
+    }
+
+    /// 最多唤醒 count 个等待在 word 上的线程
+    static void Wake(word_type& word, int count = 1)
+    {
+        if (count <= 0) {
+            return;
+        }
+
+#if XLAB_HAVE_FUTEX
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+#if defined(__cpp_lib_atomic_wait)
+        if (count == 1) {
+            word.notify_one();
+        } else {
+            word.notify_all();
+        }
+#endif
+        auto& bucket = BucketOf(&word);
+        std::lock_guard<std::mutex> lock { bucket.mutex };
+        bucket.condVar.notify_all();
+#endif
+    }
+
+    static void WakeAll(word_type& word)
+    {
+        Wake(word, INT_MAX);
+    }
+
+private:
+#if !XLAB_HAVE_FUTEX
+    struct Bucket {
+        std::mutex mutex;
+        std::condition_variable condVar;
+    };
+
+    static Bucket& BucketOf(const void* addr)
+    {
+        static Bucket buckets[64];
+        return buckets[std::hash<const void*>()(addr) % 64];
+    }
+#endif
+};
+
+}
@@ -1,13 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
+#include <chrono>
 
+#include "semaphore/futex.hpp"
 #include "time/time_utils.hpp"
 
 namespace xlab {
 
+/// 计数保存在原子变量中, 无竞争时 Post/TryWait 只有一次原子操作;
+/// 等待时先做有限次的自适应自旋, 仍拿不到再通过 futex 挂起
 class Semaphore {
 private:
     Semaphore(const Semaphore&) = delete;
@@ -19,8 +22,18 @@ private:
     Semaphore(Semaphore&& sema) = delete;
 
 public:
+    /// 慢路径统计, 拿到许可的快路径不计数
+    struct Statistic {
+        uint64_t waitCount = 0; // 未能立即拿到许可的等待次数
+        uint64_t spinCount = 0; // 自旋期间拿到许可的次数
+        uint64_t parkCount = 0; // futex 挂起次数
+        uint64_t timeoutCount = 0; // 超时返回的次数
+        uint64_t wakeupCount = 0; // Post 唤醒的线程数
+        uint64_t waitTimeNs = 0; // 自旋与挂起的累计时长
+    };
+
     Semaphore(int init_val = 0)
-        : curCount(init_val)
+        : curCount(static_cast<uint32_t>(std::max(init_val, 0)))
     {
     }
 
@@ -28,35 +41,12 @@ public:
 
     void Wait()
     {
-        while (true) {
-            std::unique_lock<std::mutex> lock { mutex };
-            if (curCount > 0) {
-                --curCount;
-                break;
-            }
-            condVar.wait(lock);
-            if (curCount > 0) {
-                --curCount;
-                break;
-            }
-        }
+        WaitFor(Futex::Infinite());
     }
 
     bool TryWait(std::chrono::nanoseconds wait_time = std::chrono::nanoseconds::zero())
     {
-        std::unique_lock<std::mutex> lock { mutex };
-        if (curCount > 0) {
-            --curCount;
-            return true;
-        }
-
-        condVar.wait_for(lock, wait_time);
-        if (curCount > 0) {
-            --curCount;
-            return true;
-        }
-
-        return false;
+        return WaitFor(wait_time);
     }
 
     template <typename Rep, typename Period>
@@ -66,19 +56,7 @@ public:
         if (nano < std::chrono::nanoseconds::zero()) {
             return false;
         }
-        std::unique_lock<std::mutex> lock { mutex };
-        if (curCount > 0) {
-            --curCount;
-            return true;
-        }
-
-        condVar.wait_for(lock, nano);
-        if (curCount > 0) {
-            --curCount;
-            return true;
-        }
-
-        return false;
+        return WaitFor(nano);
     }
 
     bool TimedWait(const Time::Interval& interval)
@@ -88,19 +66,10 @@ public:
 
     bool WaitUntil(const std::chrono::time_point<std::chrono::steady_clock>& abs_time)
     {
-        std::unique_lock<std::mutex> lock { mutex };
-        if (curCount > 0) {
-            --curCount;
-            return true;
-        }
-
-        condVar.wait_until(lock, abs_time);
-        if (curCount > 0) {
-            --curCount;
-            return true;
+        if (abs_time == std::chrono::steady_clock::time_point::max()) {
+            return WaitFor(Futex::Infinite());
         }
-
-        return false;
+        return WaitFor(std::max(abs_time - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero()));
     }
 
     bool WaitUntil(const Time::Point& point)
@@ -108,29 +77,152 @@ public:
         return WaitUntil(point.ToStedyTimePoint());
     }
 
+    /// 唤醒 min(count, 等待者数量) 个线程
     void Post(int count = 1)
     {
         if (count <= 0) {
             return;
         }
-        std::lock_guard<std::mutex> lock { mutex };
-        curCount += count;
-        condVar.notify_one();
+        curCount.fetch_add(static_cast<uint32_t>(count), std::memory_order_seq_cst);
+        const int32_t waiting = waiters.load(std::memory_order_seq_cst);
+        if (waiting > 0) {
+            const int wakeup = std::min(count, static_cast<int>(waiting));
+            Futex::Wake(curCount, wakeup);
+            statistic.wakeupCount.fetch_add(static_cast<uint64_t>(wakeup), std::memory_order_relaxed);
+        }
+    }
+
+    int Waiters() const
+    {
+        return waiters.load(std::memory_order_relaxed);
+    }
+
+    Statistic GetStatistic() const
+    {
+        Statistic result;
+        result.waitCount = statistic.waitCount.load(std::memory_order_relaxed);
+        result.spinCount = statistic.spinCount.load(std::memory_order_relaxed);
+        result.parkCount = statistic.parkCount.load(std::memory_order_relaxed);
+        result.timeoutCount = statistic.timeoutCount.load(std::memory_order_relaxed);
+        result.wakeupCount = statistic.wakeupCount.load(std::memory_order_relaxed);
+        result.waitTimeNs = statistic.waitTimeNs.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    void ResetStatistic()
+    {
+        statistic.waitCount = 0;
+        statistic.spinCount = 0;
+        statistic.parkCount = 0;
+        statistic.timeoutCount = 0;
+        statistic.wakeupCount = 0;
+        statistic.waitTimeNs = 0;
     }
 
     void ClearPost()
     {
-        std::unique_lock<std::mutex> lock { mutex };
-        if (curCount > 0) {
-            curCount = 0;
+        curCount.exchange(0, std::memory_order_acq_rel);
+    }
+
+private:
+    static constexpr int SPIN_MIN = 16;
+    static constexpr int SPIN_MAX = 1024;
+
+    bool TryAcquire()
+    {
+        uint32_t count = curCount.load(std::memory_order_relaxed);
+        while (count > 0) {
+            if (curCount.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Spin()
+    {
+        const int limit = spinLimit.load(std::memory_order_relaxed);
+        for (int i = 0; i < limit; ++i) {
+            CpuRelax();
+            if (TryAcquire()) {
+                spinLimit.store(std::min(limit * 2, SPIN_MAX), std::memory_order_relaxed);
+                return true;
+            }
+        }
+        spinLimit.store(std::max(limit / 2, SPIN_MIN), std::memory_order_relaxed);
+        return false;
+    }
+
+    bool WaitFor(std::chrono::nanoseconds wait_time)
+    {
+        if (TryAcquire()) {
+            return true;
+        }
+
+        if (wait_time <= std::chrono::nanoseconds::zero()) {
+            return false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        statistic.waitCount.fetch_add(1, std::memory_order_relaxed);
+        if (Spin()) {
+            statistic.spinCount.fetch_add(1, std::memory_order_relaxed);
+            AddWaitTime(start);
+            return true;
+        }
+
+        const bool infinite = wait_time == Futex::Infinite();
+        const auto deadline = infinite ? std::chrono::steady_clock::time_point::max() : start + wait_time;
+        while (true) {
+            const auto remain = infinite ? Futex::Infinite() : std::chrono::nanoseconds(deadline - std::chrono::steady_clock::now());
+            if (remain <= std::chrono::nanoseconds::zero()) {
+                const bool acquired = TryAcquire();
+                if (!acquired) {
+                    statistic.timeoutCount.fetch_add(1, std::memory_order_relaxed);
+                }
+                AddWaitTime(start);
+                return acquired;
+            }
+
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (TryAcquire()) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                AddWaitTime(start);
+                return true;
+            }
+            statistic.parkCount.fetch_add(1, std::memory_order_relaxed);
+            Futex::Wait(curCount, 0, remain);
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+
+            if (TryAcquire()) {
+                AddWaitTime(start);
+                return true;
+            }
         }
-        condVar.wait_for(lock, std::chrono::nanoseconds::zero());
     }
 
+    void AddWaitTime(const std::chrono::steady_clock::time_point& start)
+    {
+        const auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        statistic.waitTimeNs.fetch_add(static_cast<uint64_t>(cost.count()), std::memory_order_relaxed);
+    }
+
+private:
+    struct AtomicStatistic {
+        std::atomic<uint64_t> waitCount { 0 };
+        std::atomic<uint64_t> spinCount { 0 };
+        std::atomic<uint64_t> parkCount { 0 };
+        std::atomic<uint64_t> timeoutCount { 0 };
+        std::atomic<uint64_t> wakeupCount { 0 };
+        std::atomic<uint64_t> waitTimeNs { 0 };
+    };
+
 private:
-    int64_t curCount;
-    std::mutex mutex;
-    std::condition_variable condVar;
+    Futex::word_type curCount;
+    std::atomic<int32_t> waiters { 0 };
+    std::atomic<int> spinLimit { SPIN_MIN * 4 };
+    AtomicStatistic statistic;
 };
 
 }